@@ -20,11 +20,16 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cctype>
+#include <condition_variable>
 #include <deque>
 #include <iosfwd>
+#include <istream>
 #include <memory>
+#include <mutex>
 #include <ostream>
 #include <sstream>
+#include <string>
 #include <string_view>
 #include <utility>
 #include <vector>
@@ -42,9 +47,62 @@
 
 namespace Stockfish {
 
-constexpr auto StartFEN   = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
-constexpr int  MaxHashMB  = Is64Bit ? 33554432 : 2048;
-int            MaxThreads = std::max(1024, 4 * int(get_hardware_concurrency()));
+constexpr auto StartFEN         = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+constexpr int  MaxHashMB        = Is64Bit ? 33554432 : 2048;
+constexpr int  MaxQSearchHashKB = 65536;
+int            MaxThreads       = std::max(1024, 4 * int(get_hardware_concurrency()));
+
+namespace {
+
+// Splits a line of an EPD or FEN file into a FEN string and the id of the
+// position, taken from its "id" operation if there is one. Returns false for
+// empty lines, comments and lines too short to hold a position.
+bool parse_epd(const std::string& line, std::string& fen, std::string& id) {
+    std::istringstream is(line);
+    std::string        token;
+    int                fields = 0;
+
+    fen.clear();
+    id.clear();
+
+    // Piece placement, side to move, castling rights and en passant square
+    while (fields < 4 && is >> token)
+        fen += (fields++ ? " " : "") + token;
+
+    if (fields < 4 || fen[0] == '#')
+        return false;
+
+    // The move counters of a FEN, which an EPD does not have
+    for (int i = 0; i < 2; ++i)
+    {
+        const auto mark = is.tellg();
+
+        if (is >> token && std::all_of(token.begin(), token.end(), ::isdigit))
+            fen += " " + token;
+        else
+        {
+            is.clear();
+            is.seekg(mark);
+            break;
+        }
+    }
+
+    // EPD operations, like: bm e4; id "WAC.001";
+    std::string ops;
+    std::getline(is, ops);
+
+    for (size_t at = ops.find("id \""); at != std::string::npos; at = ops.find("id \"", at + 1))
+        if (at == 0 || ops[at - 1] == ' ' || ops[at - 1] == ';')
+        {
+            const size_t start = at + 4;
+            id                 = ops.substr(start, ops.find('"', start) - start);
+            break;
+        }
+
+    return true;
+}
+
+}
 
 Engine::Engine(std::optional<std::string> path) :
     binaryDirectory(path ? CommandLine::get_binary_directory(*path) : ""),
@@ -79,12 +137,30 @@ Engine::Engine(std::optional<std::string> path) :
           return std::nullopt;
       }));
 
+    options.add(  //
+      "QSearchHash", Option(0, 0, MaxQSearchHashKB, [this](const Option&) {
+          wait_for_search_finished();
+          threads.clear();
+          return std::nullopt;
+      }));
+
+    options.add("TTStats", Option(false));
+
     options.add(  //
       "Clear Hash", Option([this](const Option&) {
           search_clear();
           return std::nullopt;
       }));
 
+    options.add(  //
+      "Deferred Clear", Option(false));
+
+    options.add(  //
+      "Shared History", Option(false, [this](const Option&) {
+          resize_threads();
+          return std::nullopt;
+      }));
+
     options.add(  //
       "Ponder", Option(false));
 
@@ -107,9 +183,31 @@ Engine::Engine(std::optional<std::string> path) :
 
     options.add("UCI_ShowWDL", Option(false));
 
+    options.add("Info Format", Option("uci var uci var json var binary", "uci"));
+
+    options.add("Info Throttle", Option(0, 0, 5000));
+
     options.add(  //
-      "SyzygyPath", Option("", [](const Option& o) {
-          Tablebases::init(o);
+      "SyzygyPath", Option("", [this](const Option&) {
+          load_tablebases();
+          return std::nullopt;
+      }));
+
+    options.add(  //
+      "SyzygyPreload", Option("none var none var wdl var all", "none", [this](const Option&) {
+          load_tablebases();
+          return std::nullopt;
+      }));
+
+    options.add(  //
+      "SyzygyLock", Option(false, [this](const Option&) {
+          load_tablebases();
+          return std::nullopt;
+      }));
+
+    options.add(  //
+      "SyzygyIndexMemory", Option(32, 0, 4096, [this](const Option&) {
+          load_tablebases();
           return std::nullopt;
       }));
 
@@ -119,6 +217,12 @@ Engine::Engine(std::optional<std::string> path) :
 
     options.add("SyzygyProbeLimit", Option(7, 0, 7));
 
+    options.add(  //
+      "SyzygyStats", Option(false, [](const Option& o) {
+          Tablebases::collect_probe_stats(o);
+          return std::nullopt;
+      }));
+
     resize_threads();
 }
 
@@ -131,16 +235,96 @@ void Engine::go(Search::LimitsType& limits) {
 
     threads.start_thinking(options, pos, states, limits);
 }
-void Engine::stop() { threads.stop = true; }
+
+// Searches the positions of an EPD or FEN stream, one per line, until its end or
+// a line "end". Every position is searched on a single thread with the given
+// limits, and as many positions are searched in parallel as there are threads.
+// These are the threads of the pool, each with its own root, and they all share
+// the TT. The results are passed to onResult from the searching threads, as
+// they finish.
+size_t Engine::batch(std::istream&                           in,
+                     Search::LimitsType                      limits,
+                     std::function<void(const BatchResult&)> onResult) {
+
+    wait_for_search_finished();
+
+    std::vector<BatchResult>                          results(threads.size());
+    std::vector<Search::SearchManager::UpdateContext> updates(threads.size());
+
+    for (size_t i = 0; i < threads.size(); ++i)
+    {
+        BatchResult& r = results[i];
+
+        updates[i].onUpdateNoMoves = [&r](const InfoShort& info) {
+            r.depth = info.depth;
+            r.score = info.score;
+        };
+        updates[i].onUpdateFull = [&r](const InfoFull& info) {
+            r.depth = info.depth;
+            r.score = info.score;
+            r.nodes = info.nodes;
+        };
+        updates[i].onIter     = [](const InfoIter&) {};
+        updates[i].onBestmove = [&r, &onResult](std::string_view bestmove, std::string_view) {
+            r.bestmove = bestmove;
+            onResult(r);
+        };
+    }
+
+    // A search without limits would never end
+    limits.infinite   = 0;
+    limits.ponderMode = false;
+
+    std::mutex  mutex;
+    size_t      count = 0;
+    bool        ended = false;
+    std::string line, fen, id;
+
+    // Called by thread i to set up its next root. Once the stream has ended no
+    // more lines are read, as these would be the next commands on std::cin.
+    auto next = [&](size_t i, Position& p, StateInfo& st) {
+        std::unique_lock<std::mutex> lk(mutex);
+
+        while (!ended && std::getline(in, line) && !(ended = line == "end"))
+        {
+            if (!parse_epd(line, fen, id))
+                continue;
+
+            results[i]    = BatchResult{};
+            results[i].id = id.empty() ? std::to_string(count + 1) : id;
+            p.set(fen, options["UCI_Chess960"], &st);
+            count++;
+            return true;
+        }
+        ended = true;
+        return false;
+    };
+
+    // Searches of the batch do not advance the generation, their entries are
+    // then aged once for the whole batch, as for a single search.
+    tt.new_search();
+
+    threads.search_batch(options, limits, next, updates);
+
+    return count;
+}
+
+void Engine::stop() {
+    threads.flags.stop = true;
+    threads.notify_stop();
+}
 
 void Engine::search_clear() {
     wait_for_search_finished();
 
     tt.clear(threads);
-    threads.clear();
+    threads.clear(options["Deferred Clear"]);
 
     // @TODO wont work with multiple instances
-    Tablebases::init(options["SyzygyPath"]);  // Free mapped files
+    if (options["SyzygyPreload"] == "none")
+        load_tablebases();  // Free mapped files
+    else
+        Tablebases::reset_stats();
 }
 
 void Engine::set_on_update_no_moves(std::function<void(const Engine::InfoShort&)>&& f) {
@@ -161,7 +345,7 @@ void Engine::set_on_bestmove(std::function<void(std::string_view, std::string_vi
 
 void Engine::wait_for_search_finished() { threads.main_thread()->wait_for_search_finished(); }
 
-void Engine::set_position(const std::string& fen, const std::vector<std::string>& moves) {
+size_t Engine::set_position(const std::string& fen, const std::vector<std::string>& moves) {
     // Drop the old state and create a new one
     states = StateListPtr(new std::deque<StateInfo>(1));
     pos.set(fen, options["UCI_Chess960"], &states->back());
@@ -176,6 +360,8 @@ void Engine::set_position(const std::string& fen, const std::vector<std::string>
         states->emplace_back();
         pos.do_move(m, states->back());
     }
+
+    return states->size() - 1;
 }
 
 // modifiers
@@ -205,9 +391,10 @@ void Engine::set_numa_config_from_option(const std::string& o) {
 
 void Engine::resize_threads() {
     threads.wait_for_search_finished();
-    threads.set(numaContext.get_numa_config(), {options, threads, tt}, updateContext);
+    threads.set(numaContext.get_numa_config(), {options, threads, tt}, updateContext,
+                options["Threads"]);
 
-    // Reallocate the hash with the new threadpool size
+    // Set the hash size, which keeps the table when its size is unchanged
     set_tt_size(options["Hash"]);
 }
 
@@ -216,7 +403,24 @@ void Engine::set_tt_size(size_t mb) {
     tt.resize(mb, threads);
 }
 
-void Engine::set_ponderhit(bool b) { threads.main_manager()->ponder = b; }
+void Engine::load_tablebases() {
+    const auto preload = options["SyzygyPreload"] == "all" ? Tablebases::PreloadAll
+                       : options["SyzygyPreload"] == "wdl" ? Tablebases::PreloadWDL
+                                                           : Tablebases::PreloadNone;
+
+    Tablebases::init(options["SyzygyPath"], preload, options["SyzygyLock"],
+                     size_t(options["SyzygyIndexMemory"]), threads);
+}
+
+bool Engine::record_tb_probes(const std::string& file) {
+    wait_for_search_finished();
+    return Tablebases::record_probes(file);
+}
+
+void Engine::set_ponderhit(bool b) {
+    threads.main_manager()->ponder = b;
+    threads.notify_stop();
+}
 
 // utility functions
 
@@ -243,6 +447,27 @@ std::string Engine::visualize() const {
 
 int Engine::get_hashfull(int maxAge) const { return tt.hashfull(maxAge); }
 
+TTStats Engine::get_tt_stats() const { return threads.tt_stats(); }
+
+Tablebases::ProbeCacheStats Engine::get_tb_cache_stats() const { return threads.tb_cache_stats(); }
+
+Tablebases::MapStats Engine::get_tb_map_stats() const { return Tablebases::map_stats(); }
+
+Tablebases::ProbeStats Engine::get_tb_probe_stats() const { return Tablebases::probe_stats(); }
+
+uint64_t Engine::get_tt_false_hits_estimate(const TTStats& stats) const {
+    return tt.false_hits_estimate(stats);
+}
+
+uint64_t Engine::get_start_latency() const { return threads.start_latency(); }
+
+uint64_t Engine::get_tb_root_probe_time() const { return threads.tb_root_probe_time(); }
+
+TTHistogram Engine::get_tt_histogram() {
+    wait_for_search_finished();
+    return tt.histogram(threads);
+}
+
 std::vector<std::pair<size_t, size_t>> Engine::get_bound_thread_count_by_numa_node() const {
     auto                                   counts = threads.get_bound_thread_count_by_numa_node();
     const NumaConfig&                      cfg    = numaContext.get_numa_config();
@@ -22,6 +22,7 @@
 #include <cstddef>
 #include <cstdint>
 #include <functional>
+#include <iosfwd>
 #include <optional>
 #include <string>
 #include <string_view>
@@ -44,6 +45,15 @@ class Engine {
     using InfoFull  = Search::InfoFull;
     using InfoIter  = Search::InfoIteration;
 
+    // Outcome of the search of one position of a batch
+    struct BatchResult {
+        std::string id;
+        Depth       depth = 0;
+        Score       score;
+        size_t      nodes = 0;
+        std::string bestmove;
+    };
+
     Engine(std::optional<std::string> path = std::nullopt);
 
     // Cannot be movable due to components holding backreferences to fields
@@ -60,17 +70,24 @@ class Engine {
     void go(Search::LimitsType&);
     // non blocking call to stop searching
     void stop();
+    // blocking call to search the positions of a stream in parallel, see batch()
+    size_t batch(std::istream&                           in,
+                 Search::LimitsType                      limits,
+                 std::function<void(const BatchResult&)> onResult);
 
     // blocking call to wait for search to finish
     void wait_for_search_finished();
-    // set a new position, moves are in UCI format
-    void set_position(const std::string& fen, const std::vector<std::string>& moves);
+    // set a new position, moves are in UCI format. Returns the number of moves
+    // played, which stops at the first illegal one
+    size_t set_position(const std::string& fen, const std::vector<std::string>& moves);
 
     // modifiers
 
     void set_numa_config_from_option(const std::string& o);
     void resize_threads();
     void set_tt_size(size_t mb);
+    void load_tablebases();
+    bool record_tb_probes(const std::string& file);
     void set_ponderhit(bool);
     void search_clear();
 
@@ -89,6 +106,16 @@ class Engine {
 
     int get_hashfull(int maxAge = 0) const;
 
+    TTStats     get_tt_stats() const;
+    uint64_t    get_tt_false_hits_estimate(const TTStats& stats) const;
+    TTHistogram get_tt_histogram();
+    uint64_t    get_start_latency() const;
+    uint64_t    get_tb_root_probe_time() const;
+
+    Tablebases::ProbeCacheStats get_tb_cache_stats() const;
+    Tablebases::MapStats        get_tb_map_stats() const;
+    Tablebases::ProbeStats      get_tb_probe_stats() const;
+
     std::string                            fen() const;
     void                                   flip();
     std::string                            visualize() const;
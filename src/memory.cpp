@@ -28,6 +28,11 @@
     #include <sys/mman.h>
 #endif
 
+#if defined(__linux__)
+    #include <fstream>
+    #include <string>
+#endif
+
 #if defined(__APPLE__) || defined(__ANDROID__) || defined(__OpenBSD__) \
   || (defined(__GLIBCXX__) && !defined(_GLIBCXX_HAVE_ALIGNED_ALLOC) && !defined(_WIN32)) \
   || defined(__e2k__)
@@ -243,6 +248,36 @@ bool has_large_pages() {
 #endif
 }
 
+size_t available_memory() {
+
+#if defined(_WIN32)
+
+    MEMORYSTATUSEX status{};
+    status.dwLength = sizeof(status);
+    return GlobalMemoryStatusEx(&status) ? size_t(status.ullAvailPhys) : 0;
+
+#elif defined(__linux__)
+
+    std::ifstream meminfo("/proc/meminfo");
+    std::string   name;
+    size_t        kB;
+
+    while (meminfo >> name >> kB)
+    {
+        if (name == "MemAvailable:")
+            return kB * 1024;
+
+        meminfo.ignore(256, '\n');
+    }
+    return 0;
+
+#else
+
+    return 0;
+
+#endif
+}
+
 
 // aligned_large_pages_free() will free the previously memory allocated
 // by aligned_large_pages_alloc(). The effect is a nop if mem == nullptr.
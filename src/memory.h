@@ -40,6 +40,9 @@ void  aligned_large_pages_free(void* mem);
 
 bool has_large_pages();
 
+// Physical memory in bytes that can be allocated without swapping, or 0 if unknown
+size_t available_memory();
+
 // Frees memory which was placed there with placement new.
 // Works for both single objects and arrays of unknown bound.
 template<typename T, typename FREE_FUNC>
@@ -30,6 +30,7 @@
 #include <optional>
 #include <string>
 #include <string_view>
+#include <type_traits>
 #include <vector>
 
 #define stringify2(x) #x
@@ -219,13 +220,26 @@ class MultiArray {
     void fill(const U& v) {
         static_assert(Detail::is_strictly_assignable_v<T, U>,
                       "Cannot assign fill value to entry type");
-        for (auto& ele : data_)
+
+        // The entries are stored contiguously, so fill them in a single flat
+        // loop. Unlike a loop per row, it vectorizes well also when the last
+        // dimension is short, like the [COLOR_NB] of the correction histories.
+        constexpr std::size_t Count = (Size * ... * Sizes);
+
+        if constexpr (std::is_trivially_copyable_v<T> && sizeof(data_) == Count * sizeof(T))
         {
-            if constexpr (sizeof...(Sizes) == 0)
-                ele = v;
-            else
-                ele.fill(v);
+            T value;
+            value = v;
+            std::fill_n(reinterpret_cast<T*>(data_.data()), Count, value);
         }
+        else
+            for (auto& ele : data_)
+            {
+                if constexpr (sizeof...(Sizes) == 0)
+                    ele = v;
+                else
+                    ele.fill(v);
+            }
     }
 
     constexpr void swap(MultiArray<T, Size, Sizes...>& other) noexcept { data_.swap(other.data_); }
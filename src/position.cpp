@@ -404,6 +404,22 @@ Position& Position::set(const string& code, Color c, StateInfo* si) {
 }
 
 
+// Overload to initialize the position object as a copy of another one. The state
+// of pos is copied to si, earlier states are shared. Unlike a round trip through
+// pos.fen(), nothing is parsed and no part of the state, like the mobility
+// counts, has to be computed again.
+Position& Position::set(const Position& pos, StateInfo* si) {
+
+    std::memcpy(static_cast<void*>(this), &pos, sizeof(Position));
+    *si = *pos.st;
+    st  = si;
+
+    assert(pos_is_ok());
+
+    return *this;
+}
+
+
 // Returns a FEN representation of the position. In case of
 // Chess960 the Shredder-FEN notation is used. This is mainly a debugging function.
 string Position::fen() const {
@@ -725,6 +741,23 @@ DirtyPiece Position::do_move(Move                      m,
                              StateInfo&                newSt,
                              bool                      givesCheck,
                              const TranspositionTable* tt = nullptr) {
+    return make_move<false>(m, newSt, givesCheck, tt);
+}
+
+// Makes a move for consumers that only walk the board, like perft and the
+// tablebase probing code. The repetition info and the mobility counts, which
+// are only needed by the search and the evaluation, are not computed, so
+// is_draw() and is_repetition() do not see repetitions of the new position.
+// Undo with undo_move() as usual.
+void Position::do_board_move(Move m, StateInfo& newSt) {
+    make_move<true>(m, newSt, gives_check(m), nullptr);
+}
+
+template<bool BoardOnly>
+DirtyPiece Position::make_move(Move                      m,
+                               StateInfo&                newSt,
+                               bool                      givesCheck,
+                               const TranspositionTable* tt) {
 
     assert(m.is_ok());
     assert(&newSt != st);
@@ -753,7 +786,7 @@ DirtyPiece Position::do_move(Move                      m,
 
     bool checkEP = false;
 
-    DirtyPiece dp;
+    DirtyPiece dp{};
     dp.pc     = pc;
     dp.from   = from;
     dp.to     = to;
@@ -964,22 +997,26 @@ DirtyPiece Position::do_move(Move                      m,
     // occurrence of the same position, negative in the 3-fold case, or zero
     // if the position was not repeated.
     st->repetition = 0;
-    int end        = std::min(st->rule50, st->pliesFromNull);
-    if (end >= 4)
+
+    if constexpr (!BoardOnly)
     {
-        StateInfo* stp = st->previous->previous;
-        for (int i = 4; i <= end; i += 2)
+        int end = std::min(st->rule50, st->pliesFromNull);
+        if (end >= 4)
         {
-            stp = stp->previous->previous;
-            if (stp->key == st->key)
+            StateInfo* stp = st->previous->previous;
+            for (int i = 4; i <= end; i += 2)
             {
-                st->repetition = stp->repetition ? -i : i;
-                break;
+                stp = stp->previous->previous;
+                if (stp->key == st->key)
+                {
+                    st->repetition = stp->repetition ? -i : i;
+                    break;
+                }
             }
         }
-    }
 
-    update_mobility_counts();
+        update_mobility_counts();
+    }
 
     assert(pos_is_ok());
 
@@ -1130,6 +1167,15 @@ void Position::undo_null_move() {
 }
 
 
+// Returns the material key after a capture of the piece 'captured', as updated
+// by do_move(), without doing the move. Used to prefetch tablebases.
+Key Position::material_key_after_capture(Piece captured) const {
+
+    assert(pieceCount[captured] > 0);
+
+    return st->materialKey ^ Zobrist::psq[captured][8 + pieceCount[captured] - 1];
+}
+
 // Tests if the SEE (Static Exchange Evaluation)
 // value of move is greater or equal to the given threshold. We'll use an
 // algorithm similar to alpha-beta pruning with a null window.
@@ -84,6 +84,7 @@ class Position {
     // FEN string input/output
     Position&   set(const std::string& fenStr, bool isChess960, StateInfo* si);
     Position&   set(const std::string& code, Color c, StateInfo* si);
+    Position&   set(const Position& pos, StateInfo* si);
     std::string fen() const;
 
     // Position representation
@@ -135,6 +136,7 @@ class Position {
     // Doing and undoing moves
     void       do_move(Move m, StateInfo& newSt, const TranspositionTable* tt);
     DirtyPiece do_move(Move m, StateInfo& newSt, bool givesCheck, const TranspositionTable* tt);
+    void       do_board_move(Move m, StateInfo& newSt);
     void       undo_move(Move m);
     void       do_null_move(StateInfo& newSt, const TranspositionTable& tt);
     void       undo_null_move();
@@ -145,6 +147,7 @@ class Position {
     // Accessing hash keys
     Key key() const;
     Key material_key() const;
+    Key material_key_after_capture(Piece captured) const;
     Key pawn_key() const;
     Key minor_piece_key() const;
     Key non_pawn_key(Color c) const;
@@ -180,7 +183,9 @@ class Position {
     void set_check_info() const;
 
     // Other helpers
-    void move_piece(Square from, Square to);
+    template<bool BoardOnly>
+    DirtyPiece make_move(Move m, StateInfo& newSt, bool givesCheck, const TranspositionTable* tt);
+    void       move_piece(Square from, Square to);
     template<bool Do>
     void do_castling(Color             us,
                      Square            from,
@@ -57,7 +57,8 @@ void syzygy_extend_pv(const OptionsMap&            options,
                       const Search::LimitsType&    limits,
                       Stockfish::Position&         pos,
                       Stockfish::Search::RootMove& rootMove,
-                      Value&                       v);
+                      Value&                       v,
+                      Tablebases::ProbeCache*      cache);
 
 using namespace Search;
 
@@ -66,6 +67,15 @@ namespace {
 constexpr int SEARCHEDLIST_CAPACITY = 32;
 using SearchedList                  = ValueList<Move, SEARCHEDLIST_CAPACITY>;
 
+// Reductions lookup table, [depth or moveNumber]. It is the same for all threads,
+// so it is computed once at startup rather than in every Worker::clear().
+const std::array<int, MAX_MOVES> Reductions = [] {
+    std::array<int, MAX_MOVES> r{};
+    for (size_t i = 1; i < r.size(); ++i)
+        r[i] = int(2809 / 128.0 * std::log(i));
+    return r;
+}();
+
 // (*Scalers):
 // The values with Scaler asterisks have proven non-linear scaling.
 // They are optimized to time controls of 180 + 1.8 and longer,
@@ -138,13 +148,25 @@ void update_all_stats(const Position& pos,
 
 Search::Worker::Worker(SharedState&                    sharedState,
                        std::unique_ptr<ISearchManager> sm,
-                       size_t                          threadId) :
+                       size_t                          threadId,
+                       SharedHistories*                sharedHistories,
+                       bool                            clearSharedHistories) :
+    ownHistories(sharedHistories ? nullptr : make_unique_large_page<SharedHistories>()),
+    histories(sharedHistories ? *sharedHistories : *ownHistories),
+    clearsHistories(!sharedHistories || clearSharedHistories),
+    pawnHistory(histories.pawnHistory),
+    continuationHistory(histories.continuationHistory),
+    pawnCorrectionHistory(histories.pawnCorrectionHistory),
+    minorPieceCorrectionHistory(histories.minorPieceCorrectionHistory),
+    nonPawnCorrectionHistory(histories.nonPawnCorrectionHistory),
+    continuationCorrectionHistory(histories.continuationCorrectionHistory),
     // Unpack the SharedState struct into member variables
     threadIdx(threadId),
     manager(std::move(sm)),
     options(sharedState.options),
     threads(sharedState.threads),
-    tt(sharedState.tt) {
+    tt(sharedState.tt),
+    flags(&threads.flags) {
     clear();
 }
 
@@ -159,7 +181,11 @@ void Search::Worker::start_searching() {
 
     main_manager()->tm.init(limits, rootPos.side_to_move(), rootPos.game_ply(), options,
                             main_manager()->originalTimeAdjust);
-    tt.new_search();
+    main_manager()->lastPvTime = 0;
+
+    // In a batch the TT generation is advanced once, by the caller
+    if (!alone)
+        tt.new_search();
 
     if (rootMoves.empty())
     {
@@ -169,29 +195,33 @@ void Search::Worker::start_searching() {
     }
     else
     {
-        threads.start_searching();  // start non-main threads
-        iterative_deepening();      // main thread start searching
+        if (!alone)
+            threads.start_searching();  // start non-main threads
+        iterative_deepening();          // main thread start searching
     }
 
-    // When we reach the maximum depth, we can arrive here without a raise of
-    // threads.stop. However, if we are pondering or in an infinite search,
-    // the UCI protocol states that we shouldn't print the best move before the
-    // GUI sends a "stop" or "ponderhit" command. We therefore simply wait here
-    // until the GUI sends one of those commands.
-    while (!threads.stop && (main_manager()->ponder || limits.infinite))
-    {}  // Busy wait for a stop or a ponder reset
-
-    // Stop the threads if not already stopped (also raise the stop if
-    // "ponderhit" just reset threads.ponder)
-    threads.stop = true;
-
-    // Wait until all threads have finished
-    threads.wait_for_search_finished();
+    // A batch search is never pondering nor infinite, and has no helpers
+    if (!alone)
+    {
+        // When we reach the maximum depth, we can arrive here without a raise of
+        // flags->stop. However, if we are pondering or in an infinite search,
+        // the UCI protocol states that we shouldn't print the best move before the
+        // GUI sends a "stop" or "ponderhit" command. We therefore simply wait here
+        // until the GUI sends one of those commands.
+        threads.wait_for_stop([&] { return main_manager()->ponder || limits.infinite; });
+
+        // Stop the threads if not already stopped (also raise the stop if
+        // "ponderhit" just reset threads.ponder)
+        flags->stop = true;
+
+        // Wait until all threads have finished
+        threads.wait_for_search_finished();
+    }
 
     // When playing in 'nodes as time' mode, subtract the searched nodes from
     // the available ones before exiting.
     if (limits.npmsec)
-        main_manager()->tm.advance_nodes_time(threads.nodes_searched()
+        main_manager()->tm.advance_nodes_time(nodes_searched()
                                               - limits.inc[rootPos.side_to_move()]);
 
     Worker* bestThread = this;
@@ -199,7 +229,7 @@ void Search::Worker::start_searching() {
       Skill(options["Skill Level"], options["UCI_LimitStrength"] ? int(options["UCI_Elo"]) : 0);
 
     if (int(options["MultiPV"]) == 1 && !limits.depth && !limits.mate && !skill.enabled()
-        && rootMoves[0].pv[0] != Move::none())
+        && rootMoves[0].pv[0] != Move::none() && !alone)
         bestThread = threads.get_best_thread()->worker.get();
 
     main_manager()->bestPreviousScore        = bestThread->rootMoves[0].score;
@@ -207,7 +237,7 @@ void Search::Worker::start_searching() {
 
     // Send again PV info if we have a new best thread
     if (bestThread != this)
-        main_manager()->pv(*bestThread, threads, tt, bestThread->completedDepth);
+        main_manager()->pv(*bestThread, tt, bestThread->completedDepth);
 
     std::string ponder;
 
@@ -219,11 +249,32 @@ void Search::Worker::start_searching() {
     main_manager()->updates.onBestmove(bestmove, ponder);
 }
 
+// Used by ThreadPool::search_batch(), once the root of the worker is set up. For
+// the duration of the search the worker takes the given manager, which receives
+// the updates, and the given flags, so that stopping this search does not stop
+// the searches of the other threads.
+void Search::Worker::search_alone(std::unique_ptr<ISearchManager>& sm, SearchFlags& searchFlags) {
+
+    std::swap(manager, sm);
+    flags = &searchFlags;
+    alone = true;
+
+    start_searching();
+
+    alone = false;
+    flags = &threads.flags;
+    std::swap(manager, sm);
+}
+
 // Main iterative deepening loop. It calls search()
 // repeatedly with increasing depth until the allocated thinking time has been
 // consumed, the user stops the search, or the maximum search depth is reached.
 void Search::Worker::iterative_deepening() {
 
+    startLatency = std::chrono::duration_cast<std::chrono::microseconds>(
+                     std::chrono::steady_clock::now() - threads.goTime)
+                     .count();
+
     SearchManager* mainThread = (is_mainthread() ? main_manager() : nullptr);
 
     Move pv[MAX_PLY + 1];
@@ -278,8 +329,11 @@ void Search::Worker::iterative_deepening() {
 
     lowPlyHistory.fill(97);
 
+    if (!qsTT.empty())
+        qsTT.new_search();
+
     // Iterative deepening loop until requested to stop or the target depth is reached
-    while (++rootDepth < MAX_PLY && !threads.stop
+    while (++rootDepth < MAX_PLY && !flags->stop
            && !(limits.depth && mainThread && rootDepth > limits.depth))
     {
         // Age out PV variability metric
@@ -294,7 +348,7 @@ void Search::Worker::iterative_deepening() {
         size_t pvFirst = 0;
         pvLast         = 0;
 
-        if (!threads.increaseDepth)
+        if (!flags->increaseDepth)
             searchAgainCounter++;
 
         // MultiPV loop. We perform a full root search for each PV line
@@ -341,7 +395,7 @@ void Search::Worker::iterative_deepening() {
                 // If search has been stopped, we break immediately. Sorting is
                 // safe because RootMoves is still valid, although it refers to
                 // the previous iteration.
-                if (threads.stop)
+                if (flags->stop)
                     break;
 
                 // When failing high/low give some update before a re-search. To avoid
@@ -349,7 +403,7 @@ void Search::Worker::iterative_deepening() {
                 // at nodes > 10M (rather than depth N, which can be reached quickly)
                 if (mainThread && multiPV == 1 && (bestValue <= alpha || bestValue >= beta)
                     && nodes > 10000000)
-                    main_manager()->pv(*this, threads, tt, rootDepth);
+                    main_manager()->pv(*this, tt, rootDepth);
 
                 // In case of failing low/high increase aspiration window and re-search,
                 // otherwise exit the loop.
@@ -379,25 +433,26 @@ void Search::Worker::iterative_deepening() {
             std::stable_sort(rootMoves.begin() + pvFirst, rootMoves.begin() + pvIdx + 1);
 
             if (mainThread
-                && (threads.stop || pvIdx + 1 == multiPV || nodes > 10000000)
+                && (flags->stop || pvIdx + 1 == multiPV
+                    || (nodes > 10000000 && main_manager()->pv_due(options)))
                 // A thread that aborted search can have mated-in/TB-loss PV and
                 // score that cannot be trusted, i.e. it can be delayed or refuted
                 // if we would have had time to fully search other root-moves. Thus
                 // we suppress this output and below pick a proven score/PV for this
                 // thread (from the previous iteration).
-                && !(threads.abortedSearch && is_loss(rootMoves[0].uciScore)))
-                main_manager()->pv(*this, threads, tt, rootDepth);
+                && !(flags->abortedSearch && is_loss(rootMoves[0].uciScore)))
+                main_manager()->pv(*this, tt, rootDepth);
 
-            if (threads.stop)
+            if (flags->stop)
                 break;
         }
 
-        if (!threads.stop)
+        if (!flags->stop)
             completedDepth = rootDepth;
 
         // We make sure not to pick an unproven mated-in score,
         // in case this thread prematurely stopped search (aborted-search).
-        if (threads.abortedSearch && rootMoves[0].score != -VALUE_INFINITE
+        if (flags->abortedSearch && rootMoves[0].score != -VALUE_INFINITE
             && is_loss(rootMoves[0].score))
         {
             // Bring the last best move to the front for best thread selection.
@@ -423,21 +478,29 @@ void Search::Worker::iterative_deepening() {
                 || (rootMoves[0].score != -VALUE_INFINITE
                     && rootMoves[0].score <= VALUE_MATED_IN_MAX_PLY
                     && VALUE_MATE + rootMoves[0].score <= 2 * limits.mate)))
-            threads.stop = true;
+            flags->stop = true;
 
         // If the skill level is enabled and time is up, pick a sub-optimal best move
         if (skill.enabled() && skill.time_to_pick(rootDepth))
             skill.pick_best(rootMoves, multiPV);
 
         // Use part of the gained time from a previous stable move for the current move
-        for (auto&& th : threads)
+        if (alone)
         {
-            totBestMoveChanges += th->worker->bestMoveChanges;
-            th->worker->bestMoveChanges = 0;
+            totBestMoveChanges += bestMoveChanges;
+            bestMoveChanges = 0;
         }
+        else
+            for (auto&& th : threads)
+            {
+                totBestMoveChanges += th->worker->bestMoveChanges;
+                th->worker->bestMoveChanges = 0;
+            }
+
+        mainThread->tm.iteration_done(elapsed_time(), nodes_searched());
 
         // Do we have time for the next iteration? Can we stop searching now?
-        if (limits.use_time_management() && !threads.stop && !mainThread->stopOnPonderhit)
+        if (limits.use_time_management() && !flags->stop && !mainThread->stopOnPonderhit)
         {
             uint64_t nodesEffort =
               rootMoves[0].effort * 100000 / std::max(size_t(1), size_t(nodes));
@@ -454,7 +517,8 @@ void Search::Worker::iterative_deepening() {
             timeReduction = 0.723 + 0.79 / (1.104 + std::exp(-k * (completedDepth - center)));
             double reduction =
               (1.455 + mainThread->previousTimeReduction) / (2.2375 * timeReduction);
-            double bestMoveInstability = 1.04 + 1.8956 * totBestMoveChanges / threads.size();
+            double bestMoveInstability =
+              1.04 + 1.8956 * totBestMoveChanges / (alone ? 1 : threads.size());
 
             double totalTime =
               mainThread->tm.optimum() * fallingEval * reduction * bestMoveInstability;
@@ -467,26 +531,34 @@ void Search::Worker::iterative_deepening() {
 
             if (completedDepth >= 10 && nodesEffort >= 92425 && elapsedTime > totalTime * 0.666
                 && !mainThread->ponder)
-                threads.stop = true;
+                flags->stop = true;
+
+            // Stop the search if we have exceeded the totalTime or maximum, or if
+            // the next iteration is not expected to finish before them.
+            const double timeLimit = std::min(totalTime, double(mainThread->tm.maximum()));
 
-            // Stop the search if we have exceeded the totalTime or maximum
-            if (elapsedTime > std::min(totalTime, double(mainThread->tm.maximum())))
+            if (elapsedTime > timeLimit
+                || (completedDepth >= 10
+                    && elapsedTime + mainThread->tm.next_iteration_time() > timeLimit))
             {
                 // If we are allowed to ponder do not stop the search now but
                 // keep pondering until the GUI sends "ponderhit" or "stop".
                 if (mainThread->ponder)
                     mainThread->stopOnPonderhit = true;
                 else
-                    threads.stop = true;
+                    flags->stop = true;
             }
             else
-                threads.increaseDepth = mainThread->ponder || elapsedTime <= totalTime * 0.503;
+                flags->increaseDepth = mainThread->ponder || elapsedTime <= totalTime * 0.503;
         }
 
         mainThread->iterValue[iterIdx] = bestValue;
         iterIdx                        = (iterIdx + 1) & 3;
     }
 
+    // Make the totals exact once all threads are done
+    publish_counters();
+
     if (!mainThread)
         return;
 
@@ -508,7 +580,11 @@ void Search::Worker::do_move(
   Position& pos, const Move move, StateInfo& st, const bool givesCheck, Stack* const ss) {
     bool       capture = pos.capture_stage(move);
     DirtyPiece dp      = pos.do_move(move, st, givesCheck, &tt);
-    nodes.fetch_add(1, std::memory_order_relaxed);
+
+    // Other threads see the node count with a delay of at most 1024 nodes
+    if (++nodes % 1024 == 0)
+        publish_counters();
+
     if (ss != nullptr)
     {
         ss->currentMove         = move;
@@ -519,6 +595,16 @@ void Search::Worker::do_move(
 
 void Search::Worker::do_null_move(Position& pos, StateInfo& st) { pos.do_null_move(st, tt); }
 
+void Search::Worker::publish_counters() {
+    sharedCounters.nodes.store(nodes, std::memory_order_relaxed);
+    sharedCounters.tbHits.store(tbHits, std::memory_order_relaxed);
+}
+
+// Alone, the worker has exact counters of its own. Otherwise the counters of
+// the other threads lag by up to 1024 nodes, see publish_counters().
+uint64_t Search::Worker::nodes_searched() const { return alone ? nodes : threads.nodes_searched(); }
+uint64_t Search::Worker::tb_hits() const { return alone ? tbHits : threads.tb_hits(); }
+
 void Search::Worker::undo_move(Position& pos, const Move move) {
     pos.undo_move(move);
 }
@@ -528,15 +614,35 @@ void Search::Worker::undo_null_move(Position& pos) { pos.undo_null_move(); }
 
 // Reset histories, usually before a new game
 void Search::Worker::clear() {
+    clearPending = false;
+
     mainHistory.fill(68);
     captureHistory.fill(-689);
+
+    if (clearsHistories)
+        histories.clear();
+
+    ttMoveHistory = 0;
+
+    ttStats = {};
+    tbCache.clear();
+
+    // Worker::clear() runs on the worker's own thread, so the qsearch table
+    // is allocated and first touched on the NUMA node the thread is bound to.
+    const size_t qsHashKb = size_t(int(options["QSearchHash"]));
+    if (qsHashKb != qsTT.kb_size())
+        qsTT.resize_local(qsHashKb);
+    else
+        qsTT.clear_local();
+}
+
+
+void Search::SharedHistories::clear() {
     pawnHistory.fill(-1238);
     pawnCorrectionHistory.fill(5);
     minorPieceCorrectionHistory.fill(0);
     nonPawnCorrectionHistory.fill(0);
 
-    ttMoveHistory = 0;
-
     for (auto& to : continuationCorrectionHistory)
         for (auto& h : to)
             h.fill(8);
@@ -546,9 +652,24 @@ void Search::Worker::clear() {
             for (auto& to : continuationHistory[inCheck][c])
                 for (auto& h : to)
                     h.fill(-529);
+}
+
 
-    for (size_t i = 1; i < reductions.size(); ++i)
-        reductions[i] = int(2809 / 128.0 * std::log(i));
+// When the QSearchHash option is set, qsearch entries are kept in a small table
+// private to this thread, which stays resident in cache and keeps the shallow,
+// short-lived qsearch results from evicting deeper entries of the shared table.
+// On a miss the shared table is still consulted, but the returned writer always
+// points into the private table.
+std::tuple<bool, TTData, TTWriter> Search::Worker::qsearch_probe(Key key) {
+    if (qsTT.empty())
+        return tt.probe(key, ttCounters);
+
+    auto [qsHit, qsData, qsWriter] = qsTT.probe(key);
+    if (qsHit)
+        return {qsHit, qsData, qsWriter};
+
+    auto [ttHit, ttData, ttWriter] = tt.probe(key, ttCounters);
+    return {ttHit, ttData, qsWriter};
 }
 
 
@@ -618,7 +739,7 @@ Value Search::Worker::search(
     if (!rootNode)
     {
         // Step 2. Check for aborted search and immediate draw
-        if (threads.stop.load(std::memory_order_relaxed) || pos.is_draw(ss->ply)
+        if (flags->stop.load(std::memory_order_relaxed) || pos.is_draw(ss->ply)
             || ss->ply >= MAX_PLY)
             return (ss->ply >= MAX_PLY && !ss->inCheck) ? evaluate(pos) : value_draw(nodes);
 
@@ -646,7 +767,7 @@ Value Search::Worker::search(
     // Step 4. Transposition table lookup
     excludedMove                   = ss->excludedMove;
     posKey                         = pos.key();
-    auto [ttHit, ttData, ttWriter] = tt.probe(posKey);
+    auto [ttHit, ttData, ttWriter] = tt.probe(posKey, ttCounters);
     // Need further processing of the saved data
     ss->ttHit    = ttHit;
     ttData.move  = rootNode ? rootMoves[pvIdx].pv[0] : ttHit ? ttData.move : Move::none();
@@ -688,7 +809,7 @@ Value Search::Worker::search(
             {
                 pos.do_move(ttData.move, st);
                 Key nextPosKey                             = pos.key();
-                auto [ttHitNext, ttDataNext, ttWriterNext] = tt.probe(nextPosKey);
+                auto [ttHitNext, ttDataNext, ttWriterNext] = tt.probe(nextPosKey, ttCounters);
                 pos.undo_move(ttData.move);
 
                 // Check that the ttValue after the tt move would also trigger a cutoff
@@ -712,7 +833,7 @@ Value Search::Worker::search(
             && pos.rule50_count() == 0 && !pos.can_castle(ANY_CASTLING))
         {
             TB::ProbeState err;
-            TB::WDLScore   wdl = Tablebases::probe_wdl(pos, &err);
+            TB::WDLScore   wdl = Tablebases::probe_wdl(pos, &err, &tbCache);
 
             // Force check of time on the next occasion
             if (is_mainthread())
@@ -720,7 +841,7 @@ Value Search::Worker::search(
 
             if (err != TB::ProbeState::FAIL)
             {
-                tbHits.fetch_add(1, std::memory_order_relaxed);
+                tbHits++;
 
                 int drawScore = tbConfig.useRule50 ? 1 : 0;
 
@@ -753,6 +874,12 @@ Value Search::Worker::search(
                 }
             }
         }
+
+        // One capture away from the tablebases, have the tables of the captures
+        // mapped in the background before their first probe, which needs the
+        // same depth.
+        else if (piecesCount == tbConfig.cardinality + 1 && depth >= tbConfig.probeDepth)
+            Tablebases::prefetch(pos, &tbCache);
     }
 
     // Step 6. Static evaluation of the position
@@ -1251,7 +1378,7 @@ moves_loop:  // When in check, search starts here
         // Finished searching the move. If a stop occurred, the return value of
         // the search cannot be trusted, and we return immediately without updating
         // best move, principal variation nor transposition table.
-        if (threads.stop.load(std::memory_order_relaxed))
+        if (flags->stop.load(std::memory_order_relaxed))
             return VALUE_ZERO;
 
         if (rootNode)
@@ -1494,7 +1621,8 @@ Value Search::Worker::qsearch(Position& pos, Stack* ss, Value alpha, Value beta)
 
     // Step 3. Transposition table lookup
     posKey                         = pos.key();
-    auto [ttHit, ttData, ttWriter] = tt.probe(posKey);
+    auto [ttHit, ttData, ttWriter] = qsearch_probe(posKey);
+    const uint8_t ttGeneration     = qsTT.empty() ? tt.generation() : qsTT.generation();
     // Need further processing of the saved data
     ss->ttHit    = ttHit;
     ttData.move  = ttHit ? ttData.move : Move::none();
@@ -1545,7 +1673,7 @@ Value Search::Worker::qsearch(Position& pos, Stack* ss, Value alpha, Value beta)
             if (!ss->ttHit)
                 ttWriter.write(posKey, value_to_tt(bestValue, ss->ply), false, BOUND_LOWER,
                                DEPTH_UNSEARCHED, Move::none(), unadjustedStaticEval,
-                               tt.generation());
+                               ttGeneration);
             return bestValue;
         }
 
@@ -1681,7 +1809,7 @@ Value Search::Worker::qsearch(Position& pos, Stack* ss, Value alpha, Value beta)
     // is saved as it was before adjustment by correction history.
     ttWriter.write(posKey, value_to_tt(bestValue, ss->ply), pvHit,
                    bestValue >= beta ? BOUND_LOWER : BOUND_UPPER, DEPTH_QS, bestMove,
-                   unadjustedStaticEval, tt.generation());
+                   unadjustedStaticEval, ttGeneration);
 
     assert(bestValue > -VALUE_INFINITE && bestValue < VALUE_INFINITE);
 
@@ -1689,7 +1817,7 @@ Value Search::Worker::qsearch(Position& pos, Stack* ss, Value alpha, Value beta)
 }
 
 Depth Search::Worker::reduction(bool i, Depth d, int mn, int delta) const {
-    int reductionScale = reductions[d] * reductions[mn];
+    int reductionScale = Reductions[d] * Reductions[mn];
     return reductionScale - delta * 757 / rootDelta + !i * reductionScale * 218 / 512 + 1200;
 }
 
@@ -1702,7 +1830,7 @@ Depth Search::Worker::reduction(bool i, Depth d, int mn, int delta) const {
 // This function is intended for use only when printing PV outputs, and not used
 // for making decisions within the search algorithm itself.
 TimePoint Search::Worker::elapsed() const {
-    return main_manager()->tm.elapsed([this]() { return threads.nodes_searched(); });
+    return main_manager()->tm.elapsed([this]() { return nodes_searched(); });
 }
 
 TimePoint Search::Worker::elapsed_time() const { return main_manager()->tm.elapsed_time(); }
@@ -1883,6 +2011,17 @@ Move Skill::pick_best(const RootMoves& rootMoves, size_t multiPV) {
 }
 
 
+void SearchManager::clear() {
+    // These two affect the time taken on the first move of a game:
+    bestPreviousAverageScore = VALUE_INFINITE;
+    previousTimeReduction    = 0.85;
+
+    callsCnt           = 0;
+    bestPreviousScore  = VALUE_INFINITE;
+    originalTimeAdjust = -1;
+    tm.clear();
+}
+
 // Used to print debug info and, more importantly, to detect
 // when we are out of available time and thus stop the search.
 void SearchManager::check_time(Search::Worker& worker) {
@@ -1892,9 +2031,10 @@ void SearchManager::check_time(Search::Worker& worker) {
     // When using nodes, ensure checking rate is not lower than 0.1% of nodes
     callsCnt = worker.limits.nodes ? std::min(512, int(worker.limits.nodes / 1024)) : 512;
 
-    static TimePoint lastInfoTime = now();
+    // The main thread's own count is exact, the others lag by at most 1024 nodes
+    worker.publish_counters();
 
-    TimePoint elapsed = tm.elapsed([&worker]() { return worker.threads.nodes_searched(); });
+    TimePoint elapsed = tm.elapsed([&worker]() { return worker.nodes_searched(); });
     TimePoint tick    = worker.limits.startTime + elapsed;
 
     if (tick - lastInfoTime >= 1000)
@@ -1913,8 +2053,8 @@ void SearchManager::check_time(Search::Worker& worker) {
       worker.completedDepth >= 1
       && ((worker.limits.use_time_management() && (elapsed > tm.maximum() || stopOnPonderhit))
           || (worker.limits.movetime && elapsed >= worker.limits.movetime)
-          || (worker.limits.nodes && worker.threads.nodes_searched() >= worker.limits.nodes)))
-        worker.threads.stop = worker.threads.abortedSearch = true;
+          || (worker.limits.nodes && worker.nodes_searched() >= worker.limits.nodes)))
+        worker.flags->stop = worker.flags->abortedSearch = true;
 }
 
 // Used to correct and extend PVs for moves that have a TB (but not a mate) score.
@@ -1925,7 +2065,8 @@ void syzygy_extend_pv(const OptionsMap&         options,
                       const Search::LimitsType& limits,
                       Position&                 pos,
                       RootMove&                 rootMove,
-                      Value&                    v) {
+                      Value&                    v,
+                      Tablebases::ProbeCache*   cache) {
 
     auto t_start      = std::chrono::steady_clock::now();
     int  moveOverhead = int(options["Move Overhead"]);
@@ -1955,7 +2096,8 @@ void syzygy_extend_pv(const OptionsMap&         options,
         for (const auto& m : MoveList<LEGAL>(pos))
             legalMoves.emplace_back(m);
 
-        Tablebases::Config config = Tablebases::rank_root_moves(options, pos, legalMoves);
+        Tablebases::Config config =
+          Tablebases::rank_root_moves(options, pos, legalMoves, false, cache);
         RootMove&          rm     = *std::find(legalMoves.begin(), legalMoves.end(), pvMove);
 
         if (legalMoves[0].tbRank != rm.tbRank)
@@ -1996,7 +2138,7 @@ void syzygy_extend_pv(const OptionsMap&         options,
         {
             auto&     rm = legalMoves.emplace_back(m);
             StateInfo tmpSI;
-            pos.do_move(m, tmpSI);
+            pos.do_board_move(m, tmpSI);
             // Give a score of each move to break DTZ ties restricting opponent mobility,
             // but not giving the opponent a capture.
             for (const auto& mOpp : MoveList<LEGAL>(pos))
@@ -2015,7 +2157,8 @@ void syzygy_extend_pv(const OptionsMap&         options,
           [](const Search::RootMove& a, const Search::RootMove& b) { return a.tbRank > b.tbRank; });
 
         // The winning side tries to minimize DTZ, the losing side maximizes it
-        Tablebases::Config config = Tablebases::rank_root_moves(options, pos, legalMoves, true);
+        Tablebases::Config config =
+          Tablebases::rank_root_moves(options, pos, legalMoves, true, cache);
 
         // If DTZ is not available we might not find a mate, so we bail out
         if (!config.rootInTB || config.cardinality > 0)
@@ -2053,17 +2196,16 @@ void syzygy_extend_pv(const OptionsMap&         options,
           << sync_endl;
 }
 
-void SearchManager::pv(Search::Worker&           worker,
-                       const ThreadPool&         threads,
-                       const TranspositionTable& tt,
-                       Depth                     depth) {
+void SearchManager::pv(Search::Worker& worker, const TranspositionTable& tt, Depth depth) {
 
-    const auto nodes     = threads.nodes_searched();
+    worker.publish_counters();
+
+    const auto nodes     = worker.nodes_searched();
     auto&      rootMoves = worker.rootMoves;
     auto&      pos       = worker.rootPos;
     size_t     pvIdx     = worker.pvIdx;
     size_t     multiPV   = std::min(size_t(worker.options["MultiPV"]), rootMoves.size());
-    uint64_t   tbHits    = threads.tb_hits() + (worker.tbConfig.rootInTB ? rootMoves.size() : 0);
+    uint64_t   tbHits    = worker.tb_hits() + (worker.tbConfig.rootInTB ? rootMoves.size() : 0);
 
     for (size_t i = 0; i < multiPV; ++i)
     {
@@ -2086,15 +2228,7 @@ void SearchManager::pv(Search::Worker&           worker,
         // Potentially correct and extend the PV, and in exceptional cases v
         if (is_decisive(v) && std::abs(v) < VALUE_MATE_IN_MAX_PLY
             && ((!rootMoves[i].scoreLowerbound && !rootMoves[i].scoreUpperbound) || isExact))
-            syzygy_extend_pv(worker.options, worker.limits, pos, rootMoves[i], v);
-
-        std::string pv;
-        for (Move m : rootMoves[i].pv)
-            pv += UCIEngine::move(m, pos.is_chess960()) + " ";
-
-        // Remove last whitespace
-        if (!pv.empty())
-            pv.pop_back();
+            syzygy_extend_pv(worker.options, worker.limits, pos, rootMoves[i], v, &worker.tbCache);
 
         auto wdl   = worker.options["UCI_ShowWDL"] ? UCIEngine::wdl(v, pos) : "";
         auto bound = rootMoves[i].scoreLowerbound
@@ -2117,11 +2251,20 @@ void SearchManager::pv(Search::Worker&           worker,
         info.nodes     = nodes;
         info.nps       = nodes * 1000 / time;
         info.tbHits    = tbHits;
-        info.pv        = pv;
         info.hashfull  = tt.hashfull();
+        info.chess960  = pos.is_chess960();
+        info.pv        = &rootMoves[i].pv;
 
         updates.onUpdateFull(info);
     }
+
+    lastPvTime = tm.elapsed_time();
+}
+
+// With MultiPV, the lines searched so far in an iteration are shown again after
+// each one. This limits these intermediate updates to one per 'Info Throttle' ms.
+bool SearchManager::pv_due(const OptionsMap& options) const {
+    return tm.elapsed_time() - lastPvTime >= TimePoint(int(options["Info Throttle"]));
 }
 
 // Called in case we have no ponder move before exiting the search,
@@ -29,15 +29,18 @@
 #include <memory>
 #include <string>
 #include <string_view>
+#include <tuple>
 #include <vector>
 
 #include "history.h"
+#include "memory.h"
 #include "misc.h"
 #include "numa.h"
 #include "position.h"
 #include "score.h"
 #include "syzygy/tbprobe.h"
 #include "timeman.h"
+#include "tt.h"
 #include "types.h"
 
 namespace Stockfish {
@@ -49,7 +52,6 @@ enum NodeType {
     Root
 };
 
-class TranspositionTable;
 class ThreadPool;
 class OptionsMap;
 
@@ -146,6 +148,37 @@ struct SharedState {
 
 class Worker;
 
+// History tables that, with the "Shared History" option, are shared by all the
+// threads of a NUMA node. Like the TT, they are then updated without any
+// synchronization, and lost updates are accepted. Otherwise each Worker owns
+// a private set.
+struct SharedHistories {
+    void clear();
+
+    ContinuationHistory continuationHistory[2][2];
+    PawnHistory         pawnHistory;
+
+    CorrectionHistory<Pawn>         pawnCorrectionHistory;
+    CorrectionHistory<Minor>        minorPieceCorrectionHistory;
+    CorrectionHistory<NonPawn>      nonPawnCorrectionHistory;
+    CorrectionHistory<Continuation> continuationCorrectionHistory;
+};
+
+// Flags of a search, shared by the threads searching the same root. These are
+// normally the ThreadPool's, but in a batch every worker searches a root of its
+// own, with flags of its own, see Worker::search_alone().
+struct SearchFlags {
+    std::atomic_bool stop, abortedSearch, increaseDepth;
+};
+
+// Counters of a Worker that other threads read. The Worker counts in plain
+// variables and copies them here every few nodes, see publish_counters(). The
+// struct has a cache line of its own, so that these reads never invalidate the
+// line holding the data the Worker writes at every node.
+struct alignas(64) SharedCounters {
+    std::atomic<uint64_t> nodes{0}, tbHits{0};
+};
+
 // Null Object Pattern, implement a common interface for the SearchManagers.
 // A Null Object will be given to non-mainthread workers.
 class ISearchManager {
@@ -168,8 +201,11 @@ struct InfoFull: InfoShort {
     size_t           nodes;
     size_t           nps;
     size_t           tbHits;
-    std::string_view pv;
     int              hashfull;
+    bool             chess960;
+
+    // Valid only during the update, like the views above
+    const std::vector<Move>* pv;
 };
 
 struct InfoIteration {
@@ -228,10 +264,11 @@ class SearchManager: public ISearchManager {
 
     void check_time(Search::Worker& worker) override;
 
-    void pv(Search::Worker&           worker,
-            const ThreadPool&         threads,
-            const TranspositionTable& tt,
-            Depth                     depth);
+    // Resets the state carried from one search to the next, before a new game
+    void clear();
+
+    void pv(Search::Worker& worker, const TranspositionTable& tt, Depth depth);
+    bool pv_due(const OptionsMap& options) const;
 
     Stockfish::TimeManagement tm;
     double                    originalTimeAdjust;
@@ -243,6 +280,8 @@ class SearchManager: public ISearchManager {
     Value                bestPreviousScore;
     Value                bestPreviousAverageScore;
     bool                 stopOnPonderhit;
+    TimePoint            lastPvTime;
+    TimePoint            lastInfoTime = now();
 
     size_t id;
 
@@ -259,31 +298,50 @@ class NullSearchManager: public ISearchManager {
 // It is instantiated once per thread, and it is responsible for keeping track
 // of the search history, and storing data required for the search.
 class Worker {
+    // Declared first, as the references to the tables below are bound to one
+    // of these. Only the Worker that owns the tables clears them.
+    LargePagePtr<SharedHistories> ownHistories;
+    SharedHistories&              histories;
+    const bool                    clearsHistories;
+
    public:
-    Worker(SharedState&, std::unique_ptr<ISearchManager>, size_t);
+    Worker(SharedState&,
+           std::unique_ptr<ISearchManager>,
+           size_t,
+           SharedHistories* sharedHistories,
+           bool             clearSharedHistories);
 
-    // Called at instantiation to initialize reductions tables.
+    // Called at instantiation to initialize the histories.
     // Reset histories, usually before a new game.
     void clear();
 
+    // Set by a deferred ThreadPool::clear(), the clear is then done before
+    // the next search
+    bool clearPending = false;
+
     // Called when the program receives the UCI 'go' command.
     // It searches from the root position and outputs the "bestmove".
     void start_searching();
 
-    bool is_mainthread() const { return threadIdx == 0; }
+    // Searches from the root position on this thread only, while the other
+    // threads search roots of their own. The worker reports to the given
+    // manager and stops on the given flags instead of those of the pool.
+    void search_alone(std::unique_ptr<ISearchManager>& sm, SearchFlags& searchFlags);
+
+    bool is_mainthread() const { return threadIdx == 0 || alone; }
 
     // Public because they need to be updatable by the stats
     ButterflyHistory mainHistory;
     LowPlyHistory    lowPlyHistory;
 
     CapturePieceToHistory captureHistory;
-    ContinuationHistory   continuationHistory[2][2];
-    PawnHistory           pawnHistory;
+    PawnHistory&          pawnHistory;
+    ContinuationHistory (&continuationHistory)[2][2];
 
-    CorrectionHistory<Pawn>         pawnCorrectionHistory;
-    CorrectionHistory<Minor>        minorPieceCorrectionHistory;
-    CorrectionHistory<NonPawn>      nonPawnCorrectionHistory;
-    CorrectionHistory<Continuation> continuationCorrectionHistory;
+    CorrectionHistory<Pawn>&         pawnCorrectionHistory;
+    CorrectionHistory<Minor>&        minorPieceCorrectionHistory;
+    CorrectionHistory<NonPawn>&      nonPawnCorrectionHistory;
+    CorrectionHistory<Continuation>& continuationCorrectionHistory;
 
     TTMoveHistory ttMoveHistory;
 
@@ -305,14 +363,21 @@ class Worker {
     template<NodeType nodeType>
     Value qsearch(Position& pos, Stack* ss, Value alpha, Value beta);
 
+    // Probes the thread-local qsearch table, falling back to the shared one
+    std::tuple<bool, TTData, TTWriter> qsearch_probe(Key key);
+
     Depth reduction(bool i, Depth d, int mn, int delta) const;
 
     // Pointer to the search manager, only allowed to be called by the main thread
     SearchManager* main_manager() const {
-        assert(threadIdx == 0);
+        assert(is_mainthread());
         return static_cast<SearchManager*>(manager.get());
     }
 
+    // Counters of all the threads searching the root of this worker
+    uint64_t nodes_searched() const;
+    uint64_t tb_hits() const;
+
     TimePoint elapsed() const;
     TimePoint elapsed_time() const;
 
@@ -320,10 +385,16 @@ class Worker {
 
     LimitsType limits;
 
+    // Copies nodes and tbHits to sharedCounters, where other threads read them
+    void publish_counters();
+
     size_t                pvIdx, pvLast;
-    std::atomic<uint64_t> nodes, tbHits, bestMoveChanges;
+    uint64_t              nodes, tbHits;
+    std::atomic<uint64_t> bestMoveChanges;
     int                   selDepth, nmpMinPly;
 
+    SharedCounters sharedCounters;
+
     Position  rootPos;
     StateInfo rootState;
     RootMoves rootMoves;
@@ -331,9 +402,16 @@ class Worker {
     Value     rootDelta;
 
     size_t threadIdx;
+    bool   alone = false;  // Set during search_alone()
+
+    TTStats  ttStats;
+    TTStats* ttCounters   = nullptr;  // &ttStats if the TTStats option is set
+    uint64_t startLatency = 0;        // Microseconds from ThreadPool::goTime to the first node
+
+    Tablebases::ProbeCache tbCache;
 
-    // Reductions lookup table initialized at startup
-    std::array<int, MAX_MOVES> reductions;  // [depth or moveNumber]
+    // Small thread-local table for qsearch entries, see the QSearchHash option
+    TranspositionTable qsTT;
 
     // The main thread has a SearchManager, the others have a NullSearchManager
     std::unique_ptr<ISearchManager> manager;
@@ -343,6 +421,7 @@ class Worker {
     const OptionsMap&       options;
     ThreadPool&             threads;
     TranspositionTable&     tt;
+    SearchFlags*            flags;  // Those of the pool, except during search_alone()
 
     friend class Stockfish::ThreadPool;
     friend class SearchManager;
@@ -0,0 +1,232 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2025 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "spacefish.h"
+
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "bitboard.h"
+#include "engine.h"
+#include "position.h"
+#include "score.h"
+#include "search.h"
+#include "types.h"
+#include "uci.h"
+
+using namespace Stockfish;
+
+struct sf_engine {
+    Engine               engine;
+    std::vector<sf_move> pv;  // Storage for the pv of the last sf_info
+    sf_info_callback     onInfo     = nullptr;
+    void*                infoData   = nullptr;
+    sf_bestmove_callback onBestmove = nullptr;
+    void*                bestData   = nullptr;
+};
+
+namespace {
+
+// Converts a move in UCI notation, all zeros for "(none)" and "0000". Moves of
+// the pv come as Move instead, see set_pv().
+sf_move to_sf_move(std::string_view str) {
+    sf_move m{0, 0, SF_NO_PROMOTION};
+
+    if (str.size() < 4 || str[0] < 'a' || str[0] > 'h')
+        return m;
+
+    m.from = make_square(File(str[0] - 'a'), Rank(str[1] - '1'));
+    m.to   = make_square(File(str[2] - 'a'), Rank(str[3] - '1'));
+
+    if (str.size() > 4)
+        m.promotion = uint8_t(std::string_view(" pnbrqk").find(str[4]));
+
+    return m;
+}
+
+std::string to_uci(const sf_move& m) {
+    std::string str = UCIEngine::square(Square(m.from)) + UCIEngine::square(Square(m.to));
+
+    if (m.promotion != SF_NO_PROMOTION)
+        str += " pnbrqk"[m.promotion];
+
+    return str;
+}
+
+sf_score to_sf_score(const Score& s) {
+    if (s.is<Score::Mate>())
+    {
+        const int plies = s.get<Score::Mate>().plies;
+        return {SF_SCORE_MATE, (plies > 0 ? plies + 1 : plies) / 2};
+    }
+
+    if (s.is<Score::Tablebase>())
+        return {SF_SCORE_TABLEBASE, s.get<Score::Tablebase>().plies};
+
+    return {SF_SCORE_CP, s.get<Score::InternalUnits>().value};
+}
+
+// Fills e->pv with the moves of a pv
+void set_pv(sf_engine* e, const std::vector<Move>& pv, bool chess960) {
+    e->pv.clear();
+
+    for (Move m : pv)
+    {
+        Square from = m.from_sq();
+        Square to   = m.to_sq();
+
+        if (m.type_of() == CASTLING && !chess960)
+            to = make_square(to > from ? FILE_G : FILE_C, rank_of(from));
+
+        PieceType promotion = m.type_of() == PROMOTION ? m.promotion_type() : NO_PIECE_TYPE;
+        e->pv.push_back({uint8_t(from), uint8_t(to), uint8_t(promotion)});
+    }
+}
+
+}
+
+extern "C" {
+
+sf_engine* sf_engine_new(void) {
+    static std::once_flag initialized;
+
+    std::call_once(initialized, [] {
+        Bitboards::init();
+        Position::init();
+    });
+
+    sf_engine* e = new sf_engine;
+
+    e->engine.set_on_iter([](const auto&) {});
+
+    e->engine.set_on_update_no_moves([e](const Engine::InfoShort& i) {
+        if (!e->onInfo)
+            return;
+
+        sf_info info{};
+        info.depth   = i.depth;
+        info.score   = to_sf_score(i.score);
+        info.multipv = 1;
+        e->onInfo(&info, e->infoData);
+    });
+
+    e->engine.set_on_update_full([e](const Engine::InfoFull& i) {
+        if (!e->onInfo)
+            return;
+
+        set_pv(e, *i.pv, i.chess960);
+
+        sf_info info;
+        info.depth     = i.depth;
+        info.seldepth  = i.selDepth;
+        info.multipv   = uint32_t(i.multiPV);
+        info.score     = to_sf_score(i.score);
+        info.bound     = i.bound == "lowerbound" ? SF_BOUND_LOWER
+                       : i.bound == "upperbound" ? SF_BOUND_UPPER
+                                                 : SF_BOUND_EXACT;
+        info.hashfull  = i.hashfull;
+        info.time_ms   = i.timeMs;
+        info.nodes     = i.nodes;
+        info.nps       = i.nps;
+        info.tbhits    = i.tbHits;
+        info.pv        = e->pv.data();
+        info.pv_length = e->pv.size();
+        e->onInfo(&info, e->infoData);
+    });
+
+    e->engine.set_on_bestmove([e](std::string_view bestmove, std::string_view ponder) {
+        if (e->onBestmove)
+            e->onBestmove(to_sf_move(bestmove), to_sf_move(ponder), e->bestData);
+    });
+
+    return e;
+}
+
+void sf_engine_delete(sf_engine* e) {
+    if (!e)
+        return;
+
+    sf_engine_stop(e);
+    delete e;
+}
+
+int sf_engine_set_option(sf_engine* e, const char* name, const char* value) {
+    OptionsMap& options = e->engine.get_options();
+
+    if (!options.count(name))
+        return -1;
+
+    e->engine.wait_for_search_finished();
+
+    std::istringstream is(std::string("name ") + name + " value " + value);
+    options.setoption(is);
+    return 0;
+}
+
+int sf_engine_set_position(sf_engine* e, const char* fen, const sf_move* moves, size_t count) {
+    std::vector<std::string> uciMoves;
+
+    for (size_t i = 0; i < count; ++i)
+        uciMoves.push_back(to_uci(moves[i]));
+
+    e->engine.wait_for_search_finished();
+
+    const size_t played = e->engine.set_position(fen, uciMoves);
+    return played == count ? 0 : int(played + 1);
+}
+
+void sf_engine_set_info_callback(sf_engine* e, sf_info_callback callback, void* userdata) {
+    e->onInfo   = callback;
+    e->infoData = userdata;
+}
+
+void sf_engine_set_bestmove_callback(sf_engine* e, sf_bestmove_callback callback, void* userdata) {
+    e->onBestmove = callback;
+    e->bestData   = userdata;
+}
+
+void sf_engine_go(sf_engine* e, const sf_limits* l) {
+    Search::LimitsType limits;
+
+    limits.startTime   = now();
+    limits.time[WHITE] = l->time[0];
+    limits.time[BLACK] = l->time[1];
+    limits.inc[WHITE]  = l->inc[0];
+    limits.inc[BLACK]  = l->inc[1];
+    limits.movetime    = l->movetime;
+    limits.nodes       = l->nodes;
+    limits.movestogo   = l->movestogo;
+    limits.depth       = l->depth;
+    limits.mate        = l->mate;
+    limits.infinite    = !limits.use_time_management() && !limits.movetime && !limits.nodes
+                    && !limits.depth && !limits.mate;
+
+    e->engine.go(limits);
+}
+
+void sf_engine_stop(sf_engine* e) { e->engine.stop(); }
+
+void sf_engine_wait(sf_engine* e) { e->engine.wait_for_search_finished(); }
+
+void sf_engine_new_game(sf_engine* e) { e->engine.search_clear(); }
+
+}
@@ -0,0 +1,152 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2025 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// C interface of libspacefish, built with 'make libspacefish'. It lets the
+// engine be embedded in another process, with searches reported through
+// callbacks using plain structs instead of UCI text.
+
+#ifndef SPACEFISH_H_INCLUDED
+#define SPACEFISH_H_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__GNUC__)
+    #define SPACEFISH_API __attribute__((visibility("default")))
+#else
+    #define SPACEFISH_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Bumped whenever a struct or a function signature below changes
+#define SPACEFISH_API_VERSION 1
+
+typedef struct sf_engine sf_engine;
+
+// Squares are numbered from 0 (a1) to 63 (h8), file first. Castling moves go
+// from the king square to its destination, or to the rook square in Chess960,
+// as in UCI.
+typedef struct {
+    uint8_t from;
+    uint8_t to;
+    uint8_t promotion;  // One of SF_NO_PROMOTION, SF_KNIGHT ... SF_QUEEN
+} sf_move;
+
+enum {
+    SF_NO_PROMOTION = 0,
+    SF_KNIGHT       = 2,
+    SF_BISHOP       = 3,
+    SF_ROOK         = 4,
+    SF_QUEEN        = 5
+};
+
+// Scores are from the point of view of the side to move. For SF_SCORE_CP the
+// value is in centipawns, for SF_SCORE_MATE in moves to mate, negative when
+// being mated, and for SF_SCORE_TABLEBASE in plies to a tablebase win, negative
+// for a loss.
+enum {
+    SF_SCORE_CP        = 0,
+    SF_SCORE_MATE      = 1,
+    SF_SCORE_TABLEBASE = 2
+};
+
+typedef struct {
+    int32_t kind;
+    int32_t value;
+} sf_score;
+
+enum {
+    SF_BOUND_EXACT = 0,
+    SF_BOUND_LOWER = 1,
+    SF_BOUND_UPPER = 2
+};
+
+// An update on one line of the search, the equivalent of an 'info' line. The
+// pv array is only valid during the callback.
+typedef struct {
+    int32_t        depth;
+    int32_t        seldepth;
+    uint32_t       multipv;
+    sf_score       score;
+    int32_t        bound;
+    int32_t        hashfull;
+    uint64_t       time_ms;
+    uint64_t       nodes;
+    uint64_t       nps;
+    uint64_t       tbhits;
+    const sf_move* pv;
+    size_t         pv_length;
+} sf_info;
+
+// Limits of a search, with the meaning of the UCI 'go' parameters. Zero stands
+// for no limit, and a search without any limit runs until sf_engine_stop().
+typedef struct {
+    int64_t  time[2];  // Remaining time in ms, indexed by color (0 for white)
+    int64_t  inc[2];
+    int64_t  movetime;
+    uint64_t nodes;
+    int32_t  movestogo;
+    int32_t  depth;
+    int32_t  mate;
+} sf_limits;
+
+typedef void (*sf_info_callback)(const sf_info* info, void* userdata);
+
+// Called once per search, from the searching thread. The ponder move is all
+// zeros when there is none, and so is the best move when there are no legal
+// moves.
+typedef void (*sf_bestmove_callback)(sf_move bestmove, sf_move ponder, void* userdata);
+
+SPACEFISH_API sf_engine* sf_engine_new(void);
+SPACEFISH_API void       sf_engine_delete(sf_engine* engine);
+
+// Returns 0 on success and -1 if there is no such option. Values are given as
+// in UCI 'setoption', e.g. "true", "64" or "<empty>".
+SPACEFISH_API int sf_engine_set_option(sf_engine* engine, const char* name, const char* value);
+
+// Sets the position to search, a FEN followed by moves. Returns 0 on success
+// and the 1-based index of the first illegal move otherwise, in which case the
+// position is left after the legal moves before it.
+SPACEFISH_API int sf_engine_set_position(sf_engine*     engine,
+                                         const char*    fen,
+                                         const sf_move* moves,
+                                         size_t         count);
+
+// Callbacks are invoked from the searching thread, and must be set before
+// sf_engine_go(). A null callback ignores the corresponding updates.
+SPACEFISH_API void
+sf_engine_set_info_callback(sf_engine* engine, sf_info_callback callback, void* userdata);
+SPACEFISH_API void
+sf_engine_set_bestmove_callback(sf_engine* engine, sf_bestmove_callback callback, void* userdata);
+
+// Starts a search and returns immediately
+SPACEFISH_API void sf_engine_go(sf_engine* engine, const sf_limits* limits);
+SPACEFISH_API void sf_engine_stop(sf_engine* engine);
+SPACEFISH_API void sf_engine_wait(sf_engine* engine);
+
+// Forgets everything learnt from previous searches, as UCI 'ucinewgame'
+SPACEFISH_API void sf_engine_new_game(sf_engine* engine);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // #ifndef SPACEFISH_H_INCLUDED
@@ -0,0 +1,53 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2025 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Times the decoding of tablebase values, replaying the probes recorded by the
+// engine with 'tb record <file>', see the tb-benchmark target of the Makefile.
+
+#include <cstddef>
+#include <iostream>
+#include <string>
+
+#include "../bitboard.h"
+#include "../position.h"
+#include "../thread.h"
+#include "tbprobe.h"
+
+using namespace Stockfish;
+
+int main(int argc, char* argv[]) {
+
+    if (argc < 3)
+    {
+        std::cerr << "Usage: tbbench <SyzygyPath> <record file> [iterations] [index MB]"
+                  << std::endl;
+        return 1;
+    }
+
+    const int    iterations   = argc > 3 ? std::stoi(argv[3]) : 10;
+    const size_t blockIndexMB = argc > 4 ? std::stoul(argv[4]) : 32;
+
+    Bitboards::init();
+    Position::init();
+
+    ThreadPool threads;
+    Tablebases::init(argv[1], Tablebases::PreloadNone, false, blockIndexMB, threads);
+    Tablebases::replay_probes(argv[2], iterations);
+
+    return 0;
+}
@@ -21,6 +21,8 @@
 #include <algorithm>
 #include <atomic>
 #include <cassert>
+#include <chrono>
+#include <condition_variable>
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
@@ -29,10 +31,13 @@
 #include <initializer_list>
 #include <iostream>
 #include <mutex>
+#include <optional>
 #include <sstream>
 #include <string_view>
 #include <sys/stat.h>
+#include <thread>
 #include <type_traits>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -41,12 +46,15 @@
 #include "../movegen.h"
 #include "../position.h"
 #include "../search.h"
+#include "../thread.h"
 #include "../types.h"
 #include "../ucioption.h"
 
 #ifndef _WIN32
+    #include <dirent.h>
     #include <fcntl.h>
     #include <sys/mman.h>
+    #include <sys/resource.h>
     #include <unistd.h>
 #else
     #define WIN32_LEAN_AND_MEAN
@@ -65,6 +73,32 @@ namespace Stockfish {
 namespace {
 
 constexpr int TBPIECES = 7;  // Max number of supported pieces
+
+int TBGeneration = 0;  // Incremented by Tablebases::init(), to empty the probe caches
+
+// Totals of the files preloaded by the last Tablebases::init()
+std::atomic<size_t> PreloadedFiles, PreloadedBytes, LockedBytes;
+
+// Tables mapped at their first probe since the last Tablebases::reset_stats(), and
+// probes that found their table being mapped by another thread
+std::atomic<uint64_t> LazyMaps, LazyMapMicros, LongestLazyMapMicros, MapContentions;
+
+// Tables mapped in the background after a Tablebases::prefetch()
+std::atomic<uint64_t> PrefetchedMaps;
+
+// Counters of Tablebases::probe_stats(), updated only with the SyzygyStats option
+std::atomic_bool      CollectStats;
+std::atomic<uint64_t> ProbeCount, ProbeNanos, BlocksWalked, MinorFaults, MajorFaults;
+std::atomic<uint64_t> ProbeLatency[ProbeStats::Buckets];
+
+// Bytes left for the block indices of the tables mapped from now on
+std::atomic<int64_t> BlockIndexBudget;
+
+// Destination of Tablebases::record_probes(), only changed while not searching
+std::ofstream    ProbeRecord;
+std::atomic_bool Recording;
+std::mutex       RecordMutex;
+
 constexpr int MAX_DTZ =
   1 << 18;  // Max DTZ supported times 2, large enough to deal with the syzygy TB limit.
 
@@ -158,6 +192,12 @@ struct SparseEntry {
 
 static_assert(sizeof(SparseEntry) == 6, "SparseEntry must be 6 bytes");
 
+// Block of a value, and offset of the value within the block, see set_block_index()
+struct BlockEntry {
+    uint32_t block;
+    uint32_t offset;
+};
+
 using Sym = uint16_t;  // Huffman symbol
 
 struct LR {
@@ -187,22 +227,46 @@ static_assert(sizeof(LR) == 3, "LR tree entry must be 3 bytes");
 
 // class TBFile memory maps/unmaps the single .rtbw and .rtbz files. Files are
 // memory mapped for best performance. Files are mapped at first access: at init
-// time only existence of the file is checked.
-class TBFile: public std::ifstream {
+// time the directories are listed once, to know which files exist.
+class TBFile {
 
     std::string fname;
 
+    // Paths of the files found by list_files(), by file name
+    static std::unordered_map<std::string, std::string> Files;
+
    public:
-    // Look for and open the file among the Paths directories where the .rtbw
-    // and .rtbz files can be found. Multiple directories are separated by ";"
-    // on Windows and by ":" on Unix-based operating systems.
+    // Directories where the .rtbw and .rtbz files can be found. Multiple
+    // directories are separated by ";" on Windows and by ":" on Unix-based
+    // operating systems. A file present in several of them is taken from the
+    // first one.
     //
     // Example:
     // C:\tb\wdl345;C:\tb\wdl6;D:\tb\dtz345;D:\tb\dtz6
     static std::string Paths;
 
+    // Look for the file among the files found in the Paths directories
     TBFile(const std::string& f) {
 
+        auto it = Files.find(f);
+        if (it != Files.end())
+            fname = it->second;
+    }
+
+    static bool exists(const std::string& f) { return Files.count(f); }
+
+    // Number of files found with the given extension
+    static size_t count(std::string_view ext) {
+        return size_t(std::count_if(Files.begin(), Files.end(), [&](const auto& f) {
+            return f.first.size() > ext.size()
+                && f.first.compare(f.first.size() - ext.size(), ext.size(), ext) == 0;
+        }));
+    }
+
+    // Reads the contents of the Paths directories, with one listing per
+    // directory instead of trying to open every possible file in each of them.
+    static void list_files() {
+
 #ifndef _WIN32
         constexpr char SepChar = ':';
 #else
@@ -211,19 +275,47 @@ class TBFile: public std::ifstream {
         std::stringstream ss(Paths);
         std::string       path;
 
+        Files.clear();
+
+        auto add = [&](const std::string& name) {
+            if (name.size() > 5 && (name.compare(name.size() - 5, 5, ".rtbw") == 0
+                                    || name.compare(name.size() - 5, 5, ".rtbz") == 0))
+                Files.emplace(name, path + "/" + name);  // Keeps the first one found
+        };
+
         while (std::getline(ss, path, SepChar))
         {
-            fname = path + "/" + f;
-            std::ifstream::open(fname);
-            if (is_open())
-                return;
+#ifndef _WIN32
+            DIR* dir = opendir(path.c_str());
+
+            if (!dir)
+                continue;
+
+            while (const dirent* entry = readdir(dir))
+                add(entry->d_name);
+
+            closedir(dir);
+#else
+            WIN32_FIND_DATAA data;
+            HANDLE           find = FindFirstFileA((path + "\\*").c_str(), &data);
+
+            if (find == INVALID_HANDLE_VALUE)
+                continue;
+
+            do
+                add(data.cFileName);
+            while (FindNextFileA(find, &data));
+
+            FindClose(find);
+#endif
         }
     }
 
-    // Memory map the file and check it.
-    uint8_t* map(void** baseAddress, uint64_t* mapping, TBType type) {
-        if (is_open())
-            close();  // Need to re-open to get native file descriptor
+    // Memory map the file and check it. A preloaded file is read at once and,
+    // if 'lock' is set, locked in memory.
+    uint8_t* map(void** baseAddress, uint64_t* mapping, TBType type, bool preload, bool lock) {
+
+        uint64_t size;
 
 #ifndef _WIN32
         struct stat statbuf;
@@ -240,10 +332,21 @@ class TBFile: public std::ifstream {
             exit(EXIT_FAILURE);
         }
 
+        int flags = MAP_SHARED;
+    #if defined(MAP_POPULATE)
+        if (preload)
+            flags |= MAP_POPULATE;
+    #endif
+
+        size         = statbuf.st_size;
         *mapping     = statbuf.st_size;
-        *baseAddress = mmap(nullptr, statbuf.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        *baseAddress = mmap(nullptr, statbuf.st_size, PROT_READ, flags, fd, 0);
     #if defined(MADV_RANDOM)
         madvise(*baseAddress, statbuf.st_size, MADV_RANDOM);
+    #endif
+    #if defined(MADV_WILLNEED)
+        if (preload)
+            madvise(*baseAddress, statbuf.st_size, MADV_WILLNEED);
     #endif
         ::close(fd);
 
@@ -269,6 +372,7 @@ class TBFile: public std::ifstream {
             exit(EXIT_FAILURE);
         }
 
+        size        = (uint64_t(size_high) << 32) | size_low;
         HANDLE mmap = CreateFileMapping(fd, nullptr, PAGE_READONLY, size_high, size_low, nullptr);
         CloseHandle(fd);
 
@@ -299,9 +403,33 @@ class TBFile: public std::ifstream {
             return *baseAddress = nullptr, nullptr;
         }
 
+        if (preload)
+            prefault(*baseAddress, size, lock);
+
         return data + 4;  // Skip Magics's header
     }
 
+    // Reads a byte of every page of a mapped file, so that the probes do not
+    // wait for the disk, and pins the pages in memory if 'lock' is set. Locking
+    // is not done on Windows and fails silently beyond RLIMIT_MEMLOCK.
+    static void prefault(void* baseAddress, uint64_t size, bool lock) {
+
+        const volatile uint8_t* data = (const uint8_t*) baseAddress;
+
+        for (uint64_t i = 0; i < size; i += 4096)
+            (void) data[i];
+
+        PreloadedFiles++;
+        PreloadedBytes += size;
+
+#ifndef _WIN32
+        if (lock && !mlock(baseAddress, size))
+            LockedBytes += size;
+#else
+        (void) lock;
+#endif
+    }
+
     static void unmap(void* baseAddress, uint64_t mapping) {
 
 #ifndef _WIN32
@@ -313,7 +441,8 @@ class TBFile: public std::ifstream {
     }
 };
 
-std::string TBFile::Paths;
+std::string                                  TBFile::Paths;
+std::unordered_map<std::string, std::string> TBFile::Files;
 
 // struct PairsData contains low-level indexing information to access TB data.
 // There are 8, 4, or 2 PairsData records for each TBTable, according to the type
@@ -334,6 +463,10 @@ struct PairsData {
     uint8_t*     data;             // Start of Huffman compressed data
     std::vector<uint64_t>
       base64;  // base64[l - min_sym_len] is the 64bit-padded lowest symbol of length l
+    std::vector<uint8_t>
+      lenLookup;  // lenLookup[b] is the shortest l - min_sym_len of a symbol starting with byte b
+    std::vector<BlockEntry> blockIndex;  // Locates the values of index j << blockShift, or empty
+    int                     blockShift;  // when the SyzygyIndexMemory budget is exhausted
     std::vector<uint8_t>
              symlen;  // Number of values (-1) represented by a given Huffman symbol: 1..256
     Piece    pieces[TBPIECES];        // Position pieces: the order of pieces defines the groups
@@ -352,22 +485,33 @@ struct TBTable {
 
     static constexpr int Sides = Type == WDL ? 2 : 1;
 
-    std::atomic_bool ready;
-    void*            baseAddress;
-    uint8_t*         map;
-    uint64_t         mapping;
-    Key              key;
-    Key              key2;
-    int              pieceCount;
-    bool             hasPawns;
-    bool             hasUniquePieces;
-    uint8_t          pawnCount[2];     // [Lead color / other color]
-    PairsData        items[Sides][4];  // [wtm / btm][FILE_A..FILE_D or 0]
+    // States of the mapping of the file, which moves only forward. A queued
+    // table waits for TBPrefetcher, and can still be claimed by a probe.
+    enum : int {
+        Unmapped,
+        Queued,
+        Mapping,
+        Ready
+    };
+
+    std::atomic<int>      state;
+    std::atomic<uint64_t> probes;  // Counted only with the SyzygyStats option
+    void*                 baseAddress;
+    uint8_t*              map;
+    uint64_t              mapping;
+    Key                   key;
+    Key                   key2;
+    int                   pieceCount;
+    bool                  hasPawns;
+    bool                  hasUniquePieces;
+    uint8_t               pawnCount[2];     // [Lead color / other color]
+    PairsData             items[Sides][4];  // [wtm / btm][FILE_A..FILE_D or 0]
 
     PairsData* get(int stm, int f) { return &items[stm % Sides][hasPawns ? f : 0]; }
 
     TBTable() :
-        ready(false),
+        state(Unmapped),
+        probes(0),
         baseAddress(nullptr) {}
     explicit TBTable(const std::string& code);
     explicit TBTable(const TBTable<WDL>& wdl);
@@ -425,7 +569,8 @@ TBTable<DTZ>::TBTable(const TBTable<WDL>& wdl) :
 // at init time, accessed at probe time.
 class TBTables {
 
-    struct Entry {
+    // Aligned so that an entry never straddles two cache lines
+    struct alignas(32) Entry {
         Key           key;
         TBTable<WDL>* wdl;
         TBTable<DTZ>* dtz;
@@ -436,22 +581,25 @@ class TBTables {
         }
     };
 
-    static constexpr int Size     = 1 << 12;  // 4K table, indexed by key's 12 lsb
-    static constexpr int Overflow = 1;  // Number of elements allowed to map to the last bucket
+    static constexpr size_t MinSize  = 1 << 6;
+    static constexpr size_t Overflow = 1;  // Number of elements allowed to map to the last bucket
 
-    Entry hashTable[Size + Overflow];
+    // Indexed by the lsb of the keys, see reserve() for its size
+    std::vector<Entry> hashTable;
+    uint32_t           mask;
 
     std::deque<TBTable<WDL>> wdlTable;
     std::deque<TBTable<DTZ>> dtzTable;
+    std::vector<std::string> codes;  // Like "KRvK", in the order of the tables
     size_t                   foundDTZFiles = 0;
     size_t                   foundWDLFiles = 0;
 
     void insert(Key key, TBTable<WDL>* wdl, TBTable<DTZ>* dtz) {
-        uint32_t homeBucket = uint32_t(key) & (Size - 1);
+        uint32_t homeBucket = uint32_t(key) & mask;
         Entry    entry{key, wdl, dtz};
 
         // Ensure last element is empty to avoid overflow when looking up
-        for (uint32_t bucket = homeBucket; bucket < Size + Overflow - 1; ++bucket)
+        for (uint32_t bucket = homeBucket; bucket < hashTable.size() - 1; ++bucket)
         {
             Key otherKey = hashTable[bucket].key;
             if (otherKey == key || !hashTable[bucket].get<WDL>())
@@ -462,7 +610,7 @@ class TBTables {
 
             // Robin Hood hashing: If we've probed for longer than this element,
             // insert here and search for a new spot for the other element instead.
-            uint32_t otherHomeBucket = uint32_t(otherKey) & (Size - 1);
+            uint32_t otherHomeBucket = uint32_t(otherKey) & mask;
             if (otherHomeBucket > homeBucket)
             {
                 std::swap(entry, hashTable[bucket]);
@@ -470,14 +618,30 @@ class TBTables {
                 homeBucket = otherHomeBucket;
             }
         }
-        std::cerr << "TB hash table size too low!" << std::endl;
-        exit(EXIT_FAILURE);
+
+        // Too many keys at the end of the table, which is then grown. This
+        // inserts again all the tables, including the one of the displaced entry.
+        resize(2 * (size_t(mask) + 1));
+    }
+
+    // Sets the number of buckets, a power of two, and inserts the tables again
+    void resize(size_t size) {
+        hashTable.assign(size + Overflow, Entry{});
+        mask = uint32_t(size - 1);
+
+        for (size_t i = 0; i < wdlTable.size(); ++i)
+        {
+            insert(wdlTable[i].key, &wdlTable[i], &dtzTable[i]);
+            insert(wdlTable[i].key2, &wdlTable[i], &dtzTable[i]);
+        }
     }
 
    public:
+    TBTables() { resize(MinSize); }
+
     template<TBType Type>
     TBTable<Type>* get(Key key) {
-        for (const Entry* entry = &hashTable[uint32_t(key) & (Size - 1)];; ++entry)
+        for (const Entry* entry = &hashTable[uint32_t(key) & mask];; ++entry)
         {
             if (entry->key == key || !entry->get<Type>())
                 return entry->get<Type>();
@@ -485,19 +649,52 @@ class TBTables {
     }
 
     void clear() {
-        memset(hashTable, 0, sizeof(hashTable));
         wdlTable.clear();
         dtzTable.clear();
+        codes.clear();
+        resize(MinSize);
         foundDTZFiles = 0;
         foundWDLFiles = 0;
     }
 
+    // Sizes the hash table for the given number of WDL files, which take two
+    // keys each, so that it is at most half full
+    void reserve(size_t files) {
+        size_t size = MinSize;
+        while (size < 4 * files)
+            size *= 2;
+        resize(size);
+    }
+
     void info() const {
         sync_cout << "info string Found " << foundWDLFiles << " WDL and " << foundDTZFiles
                   << " DTZ tablebase files (up to " << MaxCardinality << "-man)." << sync_endl;
     }
 
     void add(const std::vector<PieceType>& pieces);
+    void preload(bool dtz, bool lock, ThreadPool& threads);
+
+    template<TBType Type>
+    PairsData* pairs_data(Key key, int stm, File f);
+
+    void map_queued(TBTable<WDL>& e);
+
+    void probe_counts(std::vector<std::pair<std::string, uint64_t>>& tables) const {
+        for (size_t i = 0; i < codes.size(); ++i)
+        {
+            if (wdlTable[i].probes)
+                tables.emplace_back(codes[i] + ".rtbw", wdlTable[i].probes);
+            if (dtzTable[i].probes)
+                tables.emplace_back(codes[i] + ".rtbz", dtzTable[i].probes);
+        }
+    }
+
+    void clear_probe_counts() {
+        for (auto& e : wdlTable)
+            e.probes = 0;
+        for (auto& e : dtzTable)
+            e.probes = 0;
+    }
 };
 
 TBTables TBTables;
@@ -512,19 +709,12 @@ void TBTables::add(const std::vector<PieceType>& pieces) {
         code += PieceToChar[pt];
     code.insert(code.find('K', 1), "v");
 
-    TBFile file_dtz(code + ".rtbz");  // KRK -> KRvK
-    if (file_dtz.is_open())
-    {
-        file_dtz.close();
+    if (TBFile::exists(code + ".rtbz"))  // KRK -> KRvK
         foundDTZFiles++;
-    }
 
-    TBFile file(code + ".rtbw");  // KRK -> KRvK
-
-    if (!file.is_open())  // Only WDL file is checked
+    if (!TBFile::exists(code + ".rtbw"))  // Only WDL file is checked
         return;
 
-    file.close();
     foundWDLFiles++;
 
     MaxCardinality = std::max(int(pieces.size()), MaxCardinality);
@@ -535,6 +725,8 @@ void TBTables::add(const std::vector<PieceType>& pieces) {
     // Insert into the hash keys for both colors: KRvK with KR white and black
     insert(wdlTable.back().key, &wdlTable.back(), &dtzTable.back());
     insert(wdlTable.back().key2, &wdlTable.back(), &dtzTable.back());
+
+    codes.push_back(code);
 }
 
 // TB tables are compressed with canonical Huffman code. The compressed data is divided into
@@ -572,30 +764,50 @@ int decompress_pairs(PairsData* d, uint64_t idx) {
     //
     //       I(k) = k * d->span + d->span / 2      (1)
 
-    // First step is to get the 'k' of the I(k) nearest to our idx, using definition (1)
-    uint32_t k = uint32_t(idx / d->span);
+    uint32_t block;
+    int      offset;
+    int      walked = 0;  // Blocks skipped to reach the one of idx
 
-    // Then we read the corresponding SparseIndex[] entry
-    uint32_t block  = number<uint32_t, LittleEndian>(&d->sparseIndex[k].block);
-    int      offset = number<uint16_t, LittleEndian>(&d->sparseIndex[k].offset);
-
-    // Now compute the difference idx - I(k). From the definition of k, we know that
-    //
-    //       idx = k * d->span + idx % d->span    (2)
-    //
-    // So from (1) and (2) we can compute idx - I(K):
-    int diff = idx % d->span - d->span / 2;
+    // When the table has a block index, it gives the block and offset of a value
+    // before idx and at most about a block away. See set_block_index().
+    if (!d->blockIndex.empty())
+    {
+        const BlockEntry& entry = d->blockIndex[idx >> d->blockShift];
 
-    // Sum the above to offset to find the offset corresponding to our idx
-    offset += diff;
+        block  = entry.block;
+        offset = int(entry.offset + (idx & ((uint64_t(1) << d->blockShift) - 1)));
+    }
+    else
+    {
+        // First step is to get the 'k' of the I(k) nearest to our idx, using definition (1)
+        uint32_t k = uint32_t(idx / d->span);
+
+        // Then we read the corresponding SparseIndex[] entry
+        block  = number<uint32_t, LittleEndian>(&d->sparseIndex[k].block);
+        offset = number<uint16_t, LittleEndian>(&d->sparseIndex[k].offset);
+
+        // Now compute the difference idx - I(k). From the definition of k, we know that
+        //
+        //       idx = k * d->span + idx % d->span    (2)
+        //
+        // So from (1) and (2) we can compute idx - I(K):
+        int diff = idx % d->span - d->span / 2;
+
+        // Sum the above to offset to find the offset corresponding to our idx
+        offset += diff;
+
+        // Move to the previous block, until offset is not negative
+        while (offset < 0)
+            offset += d->blockLength[--block] + 1, walked++;
+    }
 
-    // Move to the previous/next block, until we reach the correct block that contains idx,
+    // Move to the next block, until we reach the correct block that contains idx,
     // that is when 0 <= offset <= d->blockLength[block]
-    while (offset < 0)
-        offset += d->blockLength[--block] + 1;
-
     while (offset > d->blockLength[block])
-        offset -= d->blockLength[block++] + 1;
+        offset -= d->blockLength[block++] + 1, walked++;
+
+    if (CollectStats.load(std::memory_order_relaxed))
+        BlocksWalked.fetch_add(walked + 1, std::memory_order_relaxed);
 
     // Finally, we find the start address of our block of canonical Huffman symbols
     uint32_t* ptr = (uint32_t*) (d->data + (uint64_t(block) * d->sizeofBlock));
@@ -610,7 +822,9 @@ int decompress_pairs(PairsData* d, uint64_t idx) {
 
     while (true)
     {
-        int len = 0;  // This is the symbol length - d->min_sym_len
+        // This is the symbol length - d->min_sym_len, at least the one given by
+        // the first byte of the symbol
+        int len = d->lenLookup[buf64 >> 56];
 
         // Now get the symbol length. For any symbol s64 of length l right-padded
         // to 64 bits we know that d->base64[l-1] >= s64 >= d->base64[l] so we
@@ -708,6 +922,16 @@ int map_score(TBTable<DTZ>* entry, File f, int value, WDLScore wdl) {
     return value + 1;
 }
 
+// Writes the table and the index of a value about to be decompressed, one probe
+// per line, see Tablebases::record_probes()
+void record_probe(bool wdl, Key key, int stm, File f, uint64_t idx) {
+
+    std::scoped_lock<std::mutex> lk(RecordMutex);
+
+    ProbeRecord << (wdl ? 'w' : 'z') << ' ' << std::hex << key << std::dec << ' ' << stm << ' '
+                << int(f) << ' ' << idx << '\n';
+}
+
 // A temporary fix for the compiler bug with AVX-512. (#4450)
 #ifdef USE_AVX512
     #if defined(__clang__) && defined(__clang_major__) && __clang_major__ >= 15
@@ -935,6 +1159,9 @@ encode_remaining:
     }
 
     // Now that we have the index, decompress the pair and get the score
+    if (Recording.load(std::memory_order_relaxed))
+        record_probe(std::is_same_v<T, TBTable<WDL>>, entry->key, stm, tbFile, idx);
+
     return map_score(entry, tbFile, decompress_pairs(d, idx), wdl);
 }
 
@@ -1080,6 +1307,21 @@ uint8_t* set_sizes(PairsData* d, uint8_t* data) {
     for (int i = 0; i < base64_size; ++i)
         d->base64[i] <<= 64 - i - d->minSymLen;  // Right-padding to 64 bits
 
+    // The symbols starting with a given byte are at least as long as the highest
+    // of them, so decompress_pairs() can start its search of the length of a
+    // symbol there, and usually finds it at once.
+    d->lenLookup.resize(256);
+    for (int b = 0; b < 256; ++b)
+    {
+        uint64_t highest = (uint64_t(b) << 56) | ((uint64_t(1) << 56) - 1);
+        int      len     = 0;
+
+        while (highest < d->base64[len])
+            ++len;
+
+        d->lenLookup[b] = uint8_t(len);
+    }
+
     data += base64_size * sizeof(Sym);
     d->symlen.resize(number<uint16_t, LittleEndian>(data));
     data += sizeof(uint16_t);
@@ -1099,6 +1341,49 @@ uint8_t* set_sizes(PairsData* d, uint8_t* data) {
     return data + d->symlen.size() * sizeof(LR) + (d->symlen.size() & 1);
 }
 
+// Builds the block index of a PairsData, with an entry for about every block of
+// the table, so that decompress_pairs() finds the block of a value with a lookup
+// and usually no walk of blockLength[] from the sparse index. Tables mapped when
+// the memory budget of the block indices is exhausted keep the sparse index.
+void set_block_index(PairsData* d) {
+
+    if ((d->flags & TBFlag::SingleValue) || !d->blocksNum)
+        return;
+
+    uint64_t tbSize = d->groupIdx[std::find(d->groupLen, d->groupLen + 7, 0) - d->groupLen];
+
+    // Entries every power of two values, up to the average number of values
+    // per block, and not further apart than the entries of the sparse index
+    d->blockShift = 0;
+    while ((uint64_t(2) << d->blockShift) <= tbSize / d->blocksNum
+           && (uint64_t(2) << d->blockShift) <= d->span)
+        d->blockShift++;
+
+    size_t  size  = size_t(((tbSize - 1) >> d->blockShift) + 1);
+    int64_t bytes = int64_t(size * sizeof(BlockEntry));
+
+    if (BlockIndexBudget.fetch_sub(bytes) < bytes)
+    {
+        BlockIndexBudget.fetch_add(bytes);
+        return;
+    }
+
+    d->blockIndex.resize(size);
+
+    uint64_t first = 0;  // Index of the first value of the block
+    size_t   j     = 0;
+
+    for (uint32_t block = 0; block < d->blocksNum && j < size; ++block)
+    {
+        uint64_t next = first + d->blockLength[block] + 1;
+
+        for (; j < size && (uint64_t(j) << d->blockShift) < next; ++j)
+            d->blockIndex[j] = {block, uint32_t((uint64_t(j) << d->blockShift) - first)};
+
+        first = next;
+    }
+}
+
 uint8_t* set_dtz_map(TBTable<WDL>&, uint8_t* data, File) { return data; }
 
 uint8_t* set_dtz_map(TBTable<DTZ>& e, uint8_t* data, File maxFile) {
@@ -1195,6 +1480,7 @@ void set(T& e, uint8_t* data) {
         {
             (d = e.get(i, f))->blockLength = (uint16_t*) data;
             data += d->blockLengthSize * sizeof(uint16_t);
+            set_block_index(d);
         }
 
     for (File f = FILE_A; f <= maxFile; ++f)
@@ -1206,24 +1492,47 @@ void set(T& e, uint8_t* data) {
         }
 }
 
+// Memory maps the file of a table and inits the table. It is not thread safe:
+// it is called by the thread of mapped() that claimed the table, and at init
+// time by the thread in charge of preloading the table.
+template<TBType Type>
+void map_file(TBTable<Type>& e, const std::string& fname, bool preload, bool lock = false) {
+
+    uint8_t* data = TBFile(fname).map(&e.baseAddress, &e.mapping, Type, preload, lock);
+
+    if (data)
+        set(e, data);
+
+    e.state.store(TBTable<Type>::Ready, std::memory_order_release);
+}
+
 // If the TB file corresponding to the given position is already memory-mapped
 // then return its base address, otherwise, try to memory map and init it. Called
 // at every probe, memory map, and init only at first access. Function is thread
-// safe and can be called concurrently.
+// safe and can be called concurrently: the first thread to reach a table maps
+// it, while the other threads get nullptr, failing their probe instead of
+// waiting, until the table is ready. Different tables are mapped concurrently.
 template<TBType Type>
 void* mapped(TBTable<Type>& e, const Position& pos) {
 
-    static std::mutex mutex;
+    // Use 'acquire' to avoid a thread reading 'Ready' while another
+    // is still working. (compiler reordering may cause this).
+    int state = e.state.load(std::memory_order_acquire);
 
-    // Use 'acquire' to avoid a thread reading 'ready' == true while
-    // another is still working. (compiler reordering may cause this).
-    if (e.ready.load(std::memory_order_acquire))
+    if (state == TBTable<Type>::Ready)
         return e.baseAddress;  // Could be nullptr if file does not exist
 
-    std::scoped_lock<std::mutex> lk(mutex);
+    if (state == TBTable<Type>::Mapping
+        || !e.state.compare_exchange_strong(state, TBTable<Type>::Mapping,
+                                            std::memory_order_acquire))
+    {
+        // Lost the race to claim the table, which may be ready by now
+        if (state == TBTable<Type>::Ready)
+            return e.baseAddress;
 
-    if (e.ready.load(std::memory_order_relaxed))  // Recheck under lock
-        return e.baseAddress;
+        MapContentions.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
 
     // Pieces strings in decreasing order for each color, like ("KPP","KR")
     std::string fname, w, b;
@@ -1236,15 +1545,220 @@ void* mapped(TBTable<Type>& e, const Position& pos) {
     fname =
       (e.key == pos.material_key() ? w + 'v' + b : b + 'v' + w) + (Type == WDL ? ".rtbw" : ".rtbz");
 
-    uint8_t* data = TBFile(fname).map(&e.baseAddress, &e.mapping, Type);
+    auto start = std::chrono::steady_clock::now();
 
-    if (data)
-        set(e, data);
+    map_file(e, fname, false);
+
+    uint64_t micros = std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::steady_clock::now() - start)
+                        .count();
+    LazyMaps++;
+    LazyMapMicros += micros;
+
+    uint64_t longest = LongestLazyMapMicros;
+    while (micros > longest && !LongestLazyMapMicros.compare_exchange_weak(longest, micros))
+    {}
 
-    e.ready.store(true, std::memory_order_release);
     return e.baseAddress;
 }
 
+// Maps and reads the files of the WDL tables, and of the DTZ tables if 'dtz'
+// is set, spread over the threads of the pool. The WDL files, which are probed
+// during the search, are also locked in memory if 'lock' is set. Called at init
+// time, when no probe can run, so each table is mapped without locking by a
+// single thread.
+void TBTables::preload(bool dtz, bool lock, ThreadPool& threads) {
+
+    const size_t threadCount = threads.num_threads();
+
+    for (size_t i = 0; i < threadCount; ++i)
+        threads.run_on_thread(i, [this, i, threadCount, dtz, lock]() {
+            for (size_t t = i; t < codes.size(); t += threadCount)
+            {
+                map_file(wdlTable[t], codes[t] + ".rtbw", true, lock);
+
+                if (dtz && TBFile::exists(codes[t] + ".rtbz"))
+                    map_file(dtzTable[t], codes[t] + ".rtbz", true);
+            }
+        });
+
+    for (size_t i = 0; i < threadCount; ++i)
+        threads.wait_on_thread(i);
+}
+
+// Returns the PairsData of a recorded probe, mapping its table if needed, or
+// nullptr if there is no such table. Used by Tablebases::replay_probes() only,
+// which runs alone, so the table is mapped without claiming it.
+template<TBType Type>
+PairsData* TBTables::pairs_data(Key key, int stm, File f) {
+
+    TBTable<Type>* e = get<Type>(key);
+
+    if (!e)
+        return nullptr;
+
+    if (e->state.load() != TBTable<Type>::Ready)
+        for (size_t i = 0; i < codes.size(); ++i)
+            if ((void*) e == (void*) &wdlTable[i] || (void*) e == (void*) &dtzTable[i])
+                map_file(*e, codes[i] + (Type == WDL ? ".rtbw" : ".rtbz"), false);
+
+    return e->baseAddress ? e->get(stm, f) : nullptr;
+}
+
+// Maps a table queued by Tablebases::prefetch(), unless a probe claimed it in
+// the meantime, and asks for its index pages to be read ahead of the probes
+void TBTables::map_queued(TBTable<WDL>& e) {
+
+    int state = TBTable<WDL>::Queued;
+
+    if (!e.state.compare_exchange_strong(state, TBTable<WDL>::Mapping, std::memory_order_acquire))
+        return;
+
+    for (size_t i = 0; i < codes.size(); ++i)
+        if (&wdlTable[i] == &e)
+        {
+            map_file(e, codes[i] + ".rtbw", false);
+            break;
+        }
+
+    if (!e.baseAddress)
+        return;
+
+    PrefetchedMaps++;
+
+    // The headers, sparse indices and block lengths come before the compressed
+    // data of the first table. Symmetric tables have a single side, see set().
+    uint8_t* data = e.items[0][0].data;
+    for (int s = 0; s < (e.key != e.key2 ? 2 : 1); ++s)
+        for (int f = 0; f < (e.hasPawns ? 4 : 1); ++f)
+            data = std::min(data, e.items[s][f].data);
+
+#if !defined(_WIN32) && defined(MADV_WILLNEED)
+    madvise(e.baseAddress, size_t(data - (uint8_t*) e.baseAddress), MADV_WILLNEED);
+#endif
+}
+
+// Background thread mapping the tables queued by Tablebases::prefetch(), so that
+// the search does not wait for the mapping at the first probe of a table
+class TBPrefetcher {
+   public:
+    ~TBPrefetcher() {
+        {
+            std::scoped_lock<std::mutex> lk(mutex);
+            exit = true;
+        }
+        cv.notify_all();
+
+        if (thread.joinable())
+        {
+            // On exit() while mapping a corrupt file, the thread is the caller
+            if (thread.get_id() == std::this_thread::get_id())
+                thread.detach();
+            else
+                thread.join();
+        }
+    }
+
+    // Never waits, so as not to slow down the search: a table is not queued
+    // while the thread takes the next one, and is then mapped by its first probe.
+    bool push(TBTable<WDL>* e) {
+
+        std::unique_lock<std::mutex> lk(mutex, std::try_to_lock);
+
+        if (!lk.owns_lock() || exit)
+            return false;
+
+        if (!thread.joinable())
+            thread = std::thread(&TBPrefetcher::idle_loop, this);
+
+        queue.push_back(e);
+        cv.notify_all();
+        return true;
+    }
+
+    // Drops the queued tables, and waits for the one being mapped if any
+    void clear() {
+        std::unique_lock<std::mutex> lk(mutex);
+        queue.clear();
+        cv.wait(lk, [&] { return !busy; });
+    }
+
+   private:
+    void idle_loop() {
+
+        std::unique_lock<std::mutex> lk(mutex);
+
+        while (true)
+        {
+            cv.wait(lk, [&] { return exit || !queue.empty(); });
+
+            if (exit)
+                return;
+
+            TBTable<WDL>* e = queue.front();
+            queue.pop_front();
+            busy = true;
+
+            lk.unlock();
+            TBTables.map_queued(*e);
+            lk.lock();
+
+            busy = false;
+            cv.notify_all();
+        }
+    }
+
+    std::mutex                mutex;
+    std::condition_variable   cv;
+    std::deque<TBTable<WDL>*> queue;
+    std::thread               thread;
+    bool                      busy = false, exit = false;
+};
+
+TBPrefetcher TBPrefetcher;
+
+// Page faults of the calling thread so far, minor and major, or zeros where they
+// cannot be counted per thread
+std::pair<uint64_t, uint64_t> page_faults() {
+
+#if defined(__linux__)
+    rusage ru;
+    if (!getrusage(RUSAGE_THREAD, &ru))
+        return {uint64_t(ru.ru_minflt), uint64_t(ru.ru_majflt)};
+#endif
+
+    return {0, 0};
+}
+
+// Adds the time and the page faults between its construction and destruction to
+// the counters of Tablebases::probe_stats()
+class ProbeCounter {
+   public:
+    explicit ProbeCounter(std::atomic<uint64_t>& tableProbes) :
+        start(std::chrono::steady_clock::now()),
+        faults(page_faults()) {
+        tableProbes.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    ~ProbeCounter() {
+        uint64_t nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                           std::chrono::steady_clock::now() - start)
+                           .count();
+        auto [minor, major] = page_faults();
+        int bucket = nanos ? std::min(msb(nanos) + 1, ProbeStats::Buckets - 1) : 0;
+
+        ProbeCount.fetch_add(1, std::memory_order_relaxed);
+        ProbeNanos.fetch_add(nanos, std::memory_order_relaxed);
+        ProbeLatency[bucket].fetch_add(1, std::memory_order_relaxed);
+        MinorFaults.fetch_add(minor - faults.first, std::memory_order_relaxed);
+        MajorFaults.fetch_add(major - faults.second, std::memory_order_relaxed);
+    }
+
+   private:
+    std::chrono::steady_clock::time_point start;
+    std::pair<uint64_t, uint64_t>         faults;
+};
+
 template<TBType Type, typename Ret = typename TBTable<Type>::Ret>
 Ret probe_table(const Position& pos, ProbeState* result, WDLScore wdl = WDLDraw) {
 
@@ -1253,12 +1767,22 @@ Ret probe_table(const Position& pos, ProbeState* result, WDLScore wdl = WDLDraw)
 
     TBTable<Type>* entry = TBTables.get<Type>(pos.material_key());
 
-    if (!entry || !mapped(*entry, pos))
+    if (!entry)
+        return *result = FAIL, Ret();
+
+    // Counts the probe, including the mapping of the table at its first probe
+    std::optional<ProbeCounter> counter;
+    if (CollectStats.load(std::memory_order_relaxed))
+        counter.emplace(entry->probes);
+
+    if (!mapped(*entry, pos))
         return *result = FAIL, Ret();
 
     return do_probe_table(pos, entry, wdl, result);
 }
 
+WDLScore search_wdl(Position& pos, ProbeState* result, ProbeCache* cache);
+
 // For a position where the side to move has a winning capture it is not necessary
 // to store a winning value so the generator treats such positions as "don't care"
 // and tries to assign to it a value that improves the compression ratio. Similarly,
@@ -1273,7 +1797,7 @@ Ret probe_table(const Position& pos, ProbeState* result, WDLScore wdl = WDLDraw)
 // where the best move is an ep-move (even if losing). So in all these cases set
 // the state to ZEROING_BEST_MOVE.
 template<bool CheckZeroingMoves>
-WDLScore search(Position& pos, ProbeState* result) {
+WDLScore search(Position& pos, ProbeState* result, ProbeCache* cache) {
 
     WDLScore  value, bestValue = WDLLoss;
     StateInfo st;
@@ -1288,8 +1812,8 @@ WDLScore search(Position& pos, ProbeState* result) {
 
         moveCount++;
 
-        pos.do_move(move, st);
-        value = -search<false>(pos, result);
+        pos.do_board_move(move, st);
+        value = -search_wdl(pos, result, cache);
         pos.undo_move(move);
 
         if (*result == FAIL)
@@ -1332,21 +1856,100 @@ WDLScore search(Position& pos, ProbeState* result) {
     return *result = OK, value;
 }
 
+// search<false>(), through the cache if there is one
+WDLScore search_wdl(Position& pos, ProbeState* result, ProbeCache* cache) {
+
+    WDLScore wdl;
+
+    if (cache && cache->probe_wdl(pos.key(), wdl, *result))
+        return wdl;
+
+    wdl = search<false>(pos, result, cache);
+
+    if (cache && *result != FAIL)
+        cache->store_wdl(pos.key(), wdl, *result);
+
+    return wdl;
+}
+
+// Calls probe(pos, move, cache) for each root move until one fails. When given
+// a pool of idle threads, the moves are spread over them, each with its own copy
+// of the root position and without the cache, which is not shared. The moves
+// that failed there, possibly because their table was being mapped by another
+// thread, are probed again afterwards.
+template<typename Probe>
+bool for_each_root_move(Position&          pos,
+                        Search::RootMoves& rootMoves,
+                        ProbeCache*        cache,
+                        ThreadPool*        threads,
+                        const Probe&       probe) {
+
+    const size_t threadCount = threads ? std::min(threads->num_threads(), rootMoves.size()) : 1;
+
+    std::vector<bool> failed(rootMoves.size(), threadCount < 2);
+
+    if (threadCount >= 2)
+    {
+        // One element per thread, as elements of vector<bool> share bytes
+        std::vector<std::vector<size_t>> failedByThread(threadCount);
+
+        for (size_t i = 0; i < threadCount; ++i)
+            threads->run_on_thread(i, [&, i]() {
+                StateInfo st;
+                Position  p;
+                p.set(pos, &st);
+
+                for (size_t j = i; j < rootMoves.size(); j += threadCount)
+                    if (!probe(p, rootMoves[j], nullptr))
+                        failedByThread[i].push_back(j);
+            });
+
+        for (size_t i = 0; i < threadCount; ++i)
+        {
+            threads->wait_on_thread(i);
+
+            for (size_t j : failedByThread[i])
+                failed[j] = true;
+        }
+    }
+
+    for (size_t j = 0; j < rootMoves.size(); ++j)
+        if (failed[j] && !probe(pos, rootMoves[j], cache))
+            return false;
+
+    return true;
+}
+
 }  // namespace
 
 
 // Called at startup and after every change to
 // "SyzygyPath" UCI option to (re)create the various tables. It is not thread
 // safe, nor it needs to be.
-void Tablebases::init(const std::string& paths) {
+void Tablebases::init(const std::string& paths,
+                      PreloadMode        preload,
+                      bool               lock,
+                      size_t             blockIndexMB,
+                      ThreadPool&        threads) {
+
+    TimePoint start = now();
 
+    TBGeneration++;
+    TBPrefetcher.clear();
     TBTables.clear();
     MaxCardinality = 0;
     TBFile::Paths  = paths;
+    PreloadedFiles = PreloadedBytes = LockedBytes = 0;
+    BlockIndexBudget = int64_t(blockIndexMB) << 20;
+    reset_stats();
+
+    TBFile::list_files();
 
     if (paths.empty())
         return;
 
+    TimePoint listed = now();
+
     // MapB1H1H7[] encodes a square below a1-h8 diagonal to 0..27
     int code = 0;
     for (Square s = SQ_A1; s <= SQ_H8; ++s)
@@ -1442,6 +2045,8 @@ void Tablebases::init(const std::string& paths) {
         }
 
     // Add entries in TB tables if the corresponding ".rtbw" file exists
+    TBTables.reserve(TBFile::count(".rtbw"));
+
     for (PieceType p1 = PAWN; p1 < KING; ++p1)
     {
         TBTables.add({KING, p1, KING});
@@ -1485,6 +2090,210 @@ void Tablebases::init(const std::string& paths) {
     }
 
     TBTables.info();
+
+    TimePoint registered = now();
+
+    if (preload != PreloadNone)
+    {
+        TBTables.preload(preload == PreloadAll, lock, threads);
+
+        sync_cout << "info string Preloaded " << PreloadedFiles << " tablebase files ("
+                  << PreloadedBytes / (1024 * 1024) << " MB, " << LockedBytes / (1024 * 1024)
+                  << " MB locked) with " << threads.num_threads() << " threads." << sync_endl;
+    }
+
+    TimePoint end = now();
+
+    sync_cout << "info string Tablebase init took " << end - start << " ms (listing files "
+              << listed - start << " ms, preloading " << end - registered << " ms)." << sync_endl;
+}
+
+Tablebases::MapStats Tablebases::map_stats() {
+    return {LazyMaps, LazyMapMicros, LongestLazyMapMicros, MapContentions, PrefetchedMaps};
+}
+
+// Queues for mapping in the background the WDL tables that the side to move
+// reaches with one capture, among those not mapped yet. Called by the search one
+// capture above the cardinality, as a hint that can be ignored. With the cache of
+// the thread, positions of the same material after the first one cost nothing.
+void Tablebases::prefetch(const Position& pos, ProbeCache* cache) {
+
+    if (cache && cache->prefetched(pos.material_key()))
+        return;
+
+    const Color them    = ~pos.side_to_move();
+    bool        settled = true;  // No table of the captures is left unmapped
+
+    for (PieceType pt = PAWN; pt < KING; ++pt)
+    {
+        if (!pos.pieces(them, pt))
+            continue;
+
+        TBTable<WDL>* e =
+          TBTables.get<WDL>(pos.material_key_after_capture(make_piece(them, pt)));
+
+        int state = TBTable<WDL>::Unmapped;
+
+        if (!e || e->state.load(std::memory_order_relaxed) != state
+            || !e->state.compare_exchange_strong(state, TBTable<WDL>::Queued))
+            continue;
+
+        // Left to the first probe, unless a probe claimed it already
+        if (!TBPrefetcher.push(e))
+        {
+            state = TBTable<WDL>::Queued;
+            e->state.compare_exchange_strong(state, TBTable<WDL>::Unmapped);
+            settled = false;
+        }
+    }
+
+    if (cache && settled)
+        cache->set_prefetched(pos.material_key());
+}
+
+// Stops or starts collecting the counters of probe_stats(), which has a small
+// but measurable cost on every table probe
+void Tablebases::collect_probe_stats(bool enable) { CollectStats = enable; }
+
+void Tablebases::reset_stats() {
+
+    LazyMaps = LazyMapMicros = LongestLazyMapMicros = MapContentions = PrefetchedMaps = 0;
+    ProbeCount = ProbeNanos = BlocksWalked = MinorFaults = MajorFaults = 0;
+
+    for (auto& n : ProbeLatency)
+        n = 0;
+
+    TBTables.clear_probe_counts();
+}
+
+// Returns the counters of the table probes since the last reset_stats(), with
+// the tables sorted by decreasing number of probes
+Tablebases::ProbeStats Tablebases::probe_stats() {
+
+    ProbeStats st;
+
+    st.probes      = ProbeCount;
+    st.nanos       = ProbeNanos;
+    st.blocks      = BlocksWalked;
+    st.minorFaults = MinorFaults;
+    st.majorFaults = MajorFaults;
+
+    for (int i = 0; i < ProbeStats::Buckets; ++i)
+        st.latency[i] = ProbeLatency[i];
+
+    TBTables.probe_counts(st.tables);
+    std::stable_sort(st.tables.begin(), st.tables.end(),
+                     [](const auto& a, const auto& b) { return a.second > b.second; });
+    return st;
+}
+
+Tablebases::ProbeStats& Tablebases::ProbeStats::operator+=(const ProbeStats& other) {
+
+    probes += other.probes;
+    nanos += other.nanos;
+    blocks += other.blocks;
+    minorFaults += other.minorFaults;
+    majorFaults += other.majorFaults;
+
+    for (int i = 0; i < Buckets; ++i)
+        latency[i] += other.latency[i];
+
+    for (const auto& [name, count] : other.tables)
+    {
+        auto it = std::find_if(tables.begin(), tables.end(),
+                               [&](const auto& t) { return t.first == name; });
+        if (it != tables.end())
+            it->second += count;
+        else
+            tables.emplace_back(name, count);
+    }
+
+    std::stable_sort(tables.begin(), tables.end(),
+                     [](const auto& a, const auto& b) { return a.second > b.second; });
+    return *this;
+}
+
+// Starts writing the table and index of every value decompressed by the probes
+// to a file, to be replayed by the tbbench tool, or stops with an empty name.
+// Must not be called while searching.
+bool Tablebases::record_probes(const std::string& file) {
+
+    std::scoped_lock<std::mutex> lk(RecordMutex);
+
+    Recording = false;
+
+    if (ProbeRecord.is_open())
+        ProbeRecord.close();
+
+    if (file.empty())
+        return true;
+
+    ProbeRecord.open(file);
+    Recording = ProbeRecord.is_open();
+    return Recording;
+}
+
+// Decompresses the values of a recording of record_probes() 'iterations' times,
+// with the tables of the current SyzygyPath, and prints the time per value. The
+// checksum of the values tells whether a change of the decoder alters them, and
+// each value found with a block index is checked against the sparse index one.
+void Tablebases::replay_probes(const std::string& file, int iterations) {
+
+    struct Probe {
+        PairsData* d;
+        uint64_t   idx;
+    };
+
+    std::ifstream      in(file);
+    std::vector<Probe> probes;
+    size_t             skipped = 0;
+    char               type;
+    Key                key;
+    int                stm, f;
+    uint64_t           idx;
+
+    while (in >> type >> std::hex >> key >> std::dec >> stm >> f >> idx)
+    {
+        PairsData* d = type == 'w' ? TBTables.pairs_data<WDL>(key, stm, File(f))
+                                   : TBTables.pairs_data<DTZ>(key, stm, File(f));
+        if (d)
+            probes.push_back({d, idx});
+        else
+            skipped++;
+    }
+
+    uint64_t checksum = 0;
+    auto     start    = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < iterations; ++i)
+        for (const Probe& p : probes)
+            checksum += decompress_pairs(p.d, p.idx);
+
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start)
+                  .count();
+
+    size_t indexed = 0, mismatches = 0;
+
+    for (const Probe& p : probes)
+        if (!p.d->blockIndex.empty())
+        {
+            int value = decompress_pairs(p.d, p.idx);
+
+            // Hide the block index for a moment, nothing else runs meanwhile
+            std::vector<BlockEntry> blockIndex;
+            std::swap(blockIndex, p.d->blockIndex);
+            mismatches += decompress_pairs(p.d, p.idx) != value;
+            std::swap(blockIndex, p.d->blockIndex);
+            indexed++;
+        }
+
+    std::cout << "Probes replayed            : " << probes.size() << " x " << iterations
+              << "\nProbes without table       : " << skipped
+              << "\nProbes with a block index  : " << indexed
+              << "\nSparse index mismatches    : " << mismatches
+              << "\nNanoseconds per probe      : "
+              << ns / std::max<double>(double(probes.size()) * iterations, 1)
+              << "\nChecksum                   : " << checksum << std::endl;
 }
 
 // Probe the WDL table for a particular position.
@@ -1495,42 +2304,20 @@ void Tablebases::init(const std::string& paths) {
 //  0 : draw
 //  1 : win, but draw under 50-move rule
 //  2 : win
-WDLScore Tablebases::probe_wdl(Position& pos, ProbeState* result) {
+WDLScore Tablebases::probe_wdl(Position& pos, ProbeState* result, ProbeCache* cache) {
 
     *result = OK;
-    return search<false>(pos, result);
+    return search_wdl(pos, result, cache);
 }
 
-// Probe the DTZ table for a particular position.
-// If *result != FAIL, the probe was successful.
-// The return value is from the point of view of the side to move:
-//         n < -100 : loss, but draw under 50-move rule
-// -100 <= n < -1   : loss in n ply (assuming 50-move counter == 0)
-//        -1        : loss, the side to move is mated
-//         0        : draw
-//     1 < n <= 100 : win in n ply (assuming 50-move counter == 0)
-//   100 < n        : win, but draw under 50-move rule
-//
-// The return value n can be off by 1: a return value -n can mean a loss
-// in n+1 ply and a return value +n can mean a win in n+1 ply. This
-// cannot happen for tables with positions exactly on the "edge" of
-// the 50-move rule.
-//
-// This implies that if dtz > 0 is returned, the position is certainly
-// a win if dtz + 50-move-counter <= 99. Care must be taken that the engine
-// picks moves that preserve dtz + 50-move-counter <= 99.
-//
-// If n = 100 immediately after a capture or pawn move, then the position
-// is also certainly a win, and during the whole phase until the next
-// capture or pawn move, the inequality to be preserved is
-// dtz + 50-move-counter <= 100.
-//
-// In short, if a move is available resulting in dtz + 50-move-counter <= 99,
-// then do not accept moves leading to dtz + 50-move-counter == 100.
-int Tablebases::probe_dtz(Position& pos, ProbeState* result) {
+namespace {
+
+// probe_dtz() without the cache of its caller, but using it for the positions
+// after the moves
+int do_probe_dtz(Position& pos, ProbeState* result, ProbeCache* cache) {
 
     *result      = OK;
-    WDLScore wdl = search<true>(pos, result);
+    WDLScore wdl = search<true>(pos, result, cache);
 
     if (*result == FAIL || wdl == WDLDraw)  // DTZ tables don't store draws
         return 0;
@@ -1557,13 +2344,14 @@ int Tablebases::probe_dtz(Position& pos, ProbeState* result) {
     {
         bool zeroing = pos.capture(move) || type_of(pos.moved_piece(move)) == PAWN;
 
-        pos.do_move(move, st);
+        pos.do_board_move(move, st);
 
         // For zeroing moves we want the dtz of the move _before_ doing it,
         // otherwise we will get the dtz of the next move sequence. Search the
         // position after the move to get the score sign (because even in a
         // winning position we could make a losing capture or go for a draw).
-        dtz = zeroing ? -dtz_before_zeroing(search<false>(pos, result)) : -probe_dtz(pos, result);
+        dtz = zeroing ? -dtz_before_zeroing(search_wdl(pos, result, cache))
+                      : -probe_dtz(pos, result, cache);
 
         // If the move mates, force minDTZ to 1
         if (dtz == 1 && pos.checkers() && MoveList<LEGAL>(pos).size() == 0)
@@ -1588,6 +2376,49 @@ int Tablebases::probe_dtz(Position& pos, ProbeState* result) {
     return minDTZ == 0xFFFF ? -1 : minDTZ;
 }
 
+}  // namespace
+
+// Probe the DTZ table for a particular position.
+// If *result != FAIL, the probe was successful.
+// The return value is from the point of view of the side to move:
+//         n < -100 : loss, but draw under 50-move rule
+// -100 <= n < -1   : loss in n ply (assuming 50-move counter == 0)
+//        -1        : loss, the side to move is mated
+//         0        : draw
+//     1 < n <= 100 : win in n ply (assuming 50-move counter == 0)
+//   100 < n        : win, but draw under 50-move rule
+//
+// The return value n can be off by 1: a return value -n can mean a loss
+// in n+1 ply and a return value +n can mean a win in n+1 ply. This
+// cannot happen for tables with positions exactly on the "edge" of
+// the 50-move rule.
+//
+// This implies that if dtz > 0 is returned, the position is certainly
+// a win if dtz + 50-move-counter <= 99. Care must be taken that the engine
+// picks moves that preserve dtz + 50-move-counter <= 99.
+//
+// If n = 100 immediately after a capture or pawn move, then the position
+// is also certainly a win, and during the whole phase until the next
+// capture or pawn move, the inequality to be preserved is
+// dtz + 50-move-counter <= 100.
+//
+// In short, if a move is available resulting in dtz + 50-move-counter <= 99,
+// then do not accept moves leading to dtz + 50-move-counter == 100.
+int Tablebases::probe_dtz(Position& pos, ProbeState* result, ProbeCache* cache) {
+
+    int dtz;
+
+    if (cache && cache->probe_dtz(pos.key(), dtz, *result))
+        return dtz;
+
+    dtz = do_probe_dtz(pos, result, cache);
+
+    if (cache && *result != FAIL)
+        cache->store_dtz(pos.key(), dtz, *result);
+
+    return dtz;
+}
+
 
 // Use the DTZ tables to rank root moves.
 //
@@ -1595,10 +2426,9 @@ int Tablebases::probe_dtz(Position& pos, ProbeState* result) {
 bool Tablebases::root_probe(Position&          pos,
                             Search::RootMoves& rootMoves,
                             bool               rule50,
-                            bool               rankDTZ) {
-
-    ProbeState result = OK;
-    StateInfo  st;
+                            bool               rankDTZ,
+                            ProbeCache*        cache,
+                            ThreadPool*        threads) {
 
     // Obtain 50-move counter for the root position
     int cnt50 = pos.rule50_count();
@@ -1606,21 +2436,24 @@ bool Tablebases::root_probe(Position&          pos,
     // Check whether a position was repeated since the last zeroing move.
     bool rep = pos.has_repeated();
 
-    int dtz, bound = rule50 ? (MAX_DTZ / 2 - 100) : 1;
+    int bound = rule50 ? (MAX_DTZ / 2 - 100) : 1;
 
-    // Probe and rank each move
-    for (auto& m : rootMoves)
-    {
-        pos.do_move(m.pv[0], st);
+    // Probe and rank a move
+    auto probe = [&](Position& p, Search::RootMove& m, ProbeCache* c) {
+        ProbeState result = OK;
+        StateInfo  st;
+        int        dtz;
+
+        p.do_move(m.pv[0], st);
 
         // Calculate dtz for the current move counting from the root position
-        if (pos.rule50_count() == 0)
+        if (p.rule50_count() == 0)
         {
             // In case of a zeroing move, dtz is one of -101/-1/0/1/101
-            WDLScore wdl = -probe_wdl(pos, &result);
+            WDLScore wdl = -probe_wdl(p, &result, c);
             dtz          = dtz_before_zeroing(wdl);
         }
-        else if ((rule50 && pos.is_draw(1)) || pos.is_repetition(1))
+        else if ((rule50 && p.is_draw(1)) || p.is_repetition(1))
         {
             // In case a root move leads to a draw by repetition or 50-move rule,
             // we set dtz to zero. Note: since we are only 1 ply from the root,
@@ -1630,15 +2463,15 @@ bool Tablebases::root_probe(Position&          pos,
         else
         {
             // Otherwise, take dtz for the new position and correct by 1 ply
-            dtz = -probe_dtz(pos, &result);
+            dtz = -probe_dtz(p, &result, c);
             dtz = dtz > 0 ? dtz + 1 : dtz < 0 ? dtz - 1 : dtz;
         }
 
         // Make sure that a mating move is assigned a dtz value of 1
-        if (pos.checkers() && dtz == 2 && MoveList<LEGAL>(pos).size() == 0)
+        if (p.checkers() && dtz == 2 && MoveList<LEGAL>(p).size() == 0)
             dtz = 1;
 
-        pos.undo_move(m.pv[0]);
+        p.undo_move(m.pv[0]);
 
         if (result == FAIL)
             return false;
@@ -1661,9 +2494,11 @@ bool Tablebases::root_probe(Position&          pos,
                   : r > -bound
                     ? Value((std::min(-3, r + (MAX_DTZ / 2 - 200)) * int(PawnValue)) / 200)
                     : -VALUE_MATE + MAX_PLY + 1;
-    }
 
-    return true;
+        return true;
+    };
+
+    return for_each_root_move(pos, rootMoves, cache, threads, probe);
 }
 
 
@@ -1671,26 +2506,28 @@ bool Tablebases::root_probe(Position&          pos,
 // This is a fallback for the case that some or all DTZ tables are missing.
 //
 // A return value false indicates that not all probes were successful.
-bool Tablebases::root_probe_wdl(Position& pos, Search::RootMoves& rootMoves, bool rule50) {
+bool Tablebases::root_probe_wdl(Position&          pos,
+                                Search::RootMoves& rootMoves,
+                                bool               rule50,
+                                ProbeCache*        cache,
+                                ThreadPool*        threads) {
 
     static const int WDL_to_rank[] = {-MAX_DTZ, -MAX_DTZ + 101, 0, MAX_DTZ - 101, MAX_DTZ};
 
-    ProbeState result = OK;
-    StateInfo  st;
-    WDLScore   wdl;
+    // Probe and rank a move
+    auto probe = [&](Position& p, Search::RootMove& m, ProbeCache* c) {
+        ProbeState result = OK;
+        StateInfo  st;
+        WDLScore   wdl;
 
+        p.do_move(m.pv[0], st);
 
-    // Probe and rank each move
-    for (auto& m : rootMoves)
-    {
-        pos.do_move(m.pv[0], st);
-
-        if (pos.is_draw(1))
+        if (p.is_draw(1))
             wdl = WDLDraw;
         else
-            wdl = -probe_wdl(pos, &result);
+            wdl = -probe_wdl(p, &result, c);
 
-        pos.undo_move(m.pv[0]);
+        p.undo_move(m.pv[0]);
 
         if (result == FAIL)
             return false;
@@ -1700,15 +2537,19 @@ bool Tablebases::root_probe_wdl(Position& pos, Search::RootMoves& rootMoves, boo
         if (!rule50)
             wdl = wdl > WDLDraw ? WDLWin : wdl < WDLDraw ? WDLLoss : WDLDraw;
         m.tbScore = WDL_to_value[wdl + 2];
-    }
 
-    return true;
+        return true;
+    };
+
+    return for_each_root_move(pos, rootMoves, cache, threads, probe);
 }
 
 Config Tablebases::rank_root_moves(const OptionsMap&  options,
                                    Position&          pos,
                                    Search::RootMoves& rootMoves,
-                                   bool               rankDTZ) {
+                                   bool               rankDTZ,
+                                   ProbeCache*        cache,
+                                   ThreadPool*        threads) {
     Config config;
 
     if (rootMoves.empty())
@@ -1732,13 +2573,15 @@ Config Tablebases::rank_root_moves(const OptionsMap&  options,
     if (config.cardinality >= popcount(pos.pieces()) && !pos.can_castle(ANY_CASTLING))
     {
         // Rank moves using DTZ tables
-        config.rootInTB = root_probe(pos, rootMoves, options["Syzygy50MoveRule"], rankDTZ);
+        config.rootInTB =
+          root_probe(pos, rootMoves, options["Syzygy50MoveRule"], rankDTZ, cache, threads);
 
         if (!config.rootInTB)
         {
             // DTZ tables are missing; try to rank moves using WDL tables
             dtz_available   = false;
-            config.rootInTB = root_probe_wdl(pos, rootMoves, options["Syzygy50MoveRule"]);
+            config.rootInTB =
+              root_probe_wdl(pos, rootMoves, options["Syzygy50MoveRule"], cache, threads);
         }
     }
 
@@ -1762,4 +2605,77 @@ Config Tablebases::rank_root_moves(const OptionsMap&  options,
 
     return config;
 }
+
+void ProbeCache::clear() {
+    std::fill(std::begin(entries), std::end(entries), Entry{0, 0, 0, Unknown, Unknown});
+    generation    = TBGeneration;
+    prefetchedKey = 0;
+    stats         = {};
+}
+
+// Returns the entry of the key. When storing, an entry of another key is reset,
+// but an entry of the same key keeps its other result.
+ProbeCache::Entry& ProbeCache::entry(uint64_t key, bool reset) {
+
+    if (generation != TBGeneration)
+    {
+        const ProbeCacheStats st = stats;
+        clear();
+        stats = st;
+    }
+
+    Entry& e = entries[key & (Size - 1)];
+
+    if (reset && e.key != key)
+        e = {key, 0, 0, Unknown, Unknown};
+
+    return e;
+}
+
+bool ProbeCache::probe_wdl(uint64_t key, WDLScore& wdl, ProbeState& state) {
+
+    const Entry& e = entry(key, false);
+    const bool   hit = e.key == key && e.wdlState != Unknown;
+
+    stats.probes++;
+    stats.hits += hit;
+
+    if (hit)
+        wdl = WDLScore(e.wdl), state = ProbeState(e.wdlState);
+
+    return hit;
+}
+
+bool ProbeCache::probe_dtz(uint64_t key, int& dtz, ProbeState& state) {
+
+    const Entry& e = entry(key, false);
+    const bool   hit = e.key == key && e.dtzState != Unknown;
+
+    stats.probes++;
+    stats.hits += hit;
+
+    if (hit)
+        dtz = e.dtz, state = ProbeState(e.dtzState);
+
+    return hit;
+}
+
+void ProbeCache::store_wdl(uint64_t key, WDLScore wdl, ProbeState state) {
+
+    Entry& e   = entry(key, true);
+    e.wdl      = int8_t(wdl);
+    e.wdlState = int8_t(state);
+}
+
+void ProbeCache::store_dtz(uint64_t key, int dtz, ProbeState state) {
+
+    Entry& e   = entry(key, true);
+    e.dtz      = int16_t(dtz);
+    e.dtzState = int8_t(state);
+}
+
+bool ProbeCache::prefetched(uint64_t materialKey) const {
+    return materialKey == prefetchedKey && generation == TBGeneration;
+}
+
 }  // namespace Stockfish
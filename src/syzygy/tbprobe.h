@@ -19,13 +19,17 @@
 #ifndef TBPROBE_H
 #define TBPROBE_H
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
+#include <utility>
 #include <vector>
 
 
 namespace Stockfish {
 class Position;
 class OptionsMap;
+class ThreadPool;
 
 using Depth = int;
 
@@ -60,18 +64,138 @@ enum ProbeState {
     ZEROING_BEST_MOVE = 2    // Best move zeroes DTZ (capture or pawn move)
 };
 
+// Tables mapped and faulted in by init() rather than at their first probe,
+// see the SyzygyPreload option
+enum PreloadMode {
+    PreloadNone,
+    PreloadWDL,
+    PreloadAll
+};
+
+// Tables mapped at their first probe since the last reset_stats(), the time it took,
+// and the probes that failed because another thread was mapping their table
+struct MapStats {
+    uint64_t maps          = 0;
+    uint64_t totalMicros   = 0;
+    uint64_t longestMicros = 0;
+    uint64_t contentions   = 0;
+    uint64_t prefetched    = 0;  // Mapped in the background, see prefetch()
+
+    MapStats& operator+=(const MapStats& other) {
+        maps += other.maps;
+        totalMicros += other.totalMicros;
+        longestMicros = longestMicros > other.longestMicros ? longestMicros : other.longestMicros;
+        contentions += other.contentions;
+        prefetched += other.prefetched;
+        return *this;
+    }
+};
+
+// Counters of the table probes since the last reset_stats(), collected only with
+// the SyzygyStats option. A probe is timed from the lookup of its table, so the
+// first one of each table includes its mapping. Page faults are counted on Linux
+// only.
+struct ProbeStats {
+    static constexpr int Buckets = 24;  // The last one also counts the slower probes
+
+    uint64_t probes           = 0;
+    uint64_t nanos            = 0;
+    uint64_t blocks           = 0;   // Blocks read to locate the values, at least one per probe
+    uint64_t minorFaults      = 0;
+    uint64_t majorFaults      = 0;
+    uint64_t latency[Buckets] = {};  // Probes of 2^(i-1) to 2^i - 1 nanoseconds
+
+    std::vector<std::pair<std::string, uint64_t>> tables;  // Probes per file, most first
+
+    ProbeStats& operator+=(const ProbeStats& other);
+};
+
+struct ProbeCacheStats {
+    uint64_t probes = 0;
+    uint64_t hits   = 0;
+
+    ProbeCacheStats& operator+=(const ProbeCacheStats& other) {
+        probes += other.probes;
+        hits += other.hits;
+        return *this;
+    }
+};
+
+// Results of recent WDL and DTZ probes, indexed and checked by position key,
+// so that positions probed again skip the resolution of captures and the
+// decompression of the tables. A cache belongs to a single thread and needs no
+// locking. It empties itself when the tables are reloaded.
+class ProbeCache {
+   public:
+    ProbeCache() { clear(); }
+
+    void clear();
+
+    bool probe_wdl(uint64_t key, WDLScore& wdl, ProbeState& state);
+    bool probe_dtz(uint64_t key, int& dtz, ProbeState& state);
+    void store_wdl(uint64_t key, WDLScore wdl, ProbeState state);
+    void store_dtz(uint64_t key, int dtz, ProbeState state);
+
+    // Material key of the last position whose capture tables prefetch() has
+    // all queued, or found mapped or missing, so that it skips them next time
+    bool prefetched(uint64_t materialKey) const;
+    void set_prefetched(uint64_t materialKey) { prefetchedKey = materialKey; }
+
+    ProbeCacheStats stats;
+
+   private:
+    static constexpr size_t Size    = 4096;
+    static constexpr int8_t Unknown = -128;  // State of a result not stored yet
+
+    struct Entry {
+        uint64_t key;
+        int16_t  dtz;
+        int8_t   wdl;
+        int8_t   wdlState;
+        int8_t   dtzState;
+    };
+
+    Entry& entry(uint64_t key, bool reset);
+
+    Entry    entries[Size];
+    int      generation;
+    uint64_t prefetchedKey;
+};
+
 extern int MaxCardinality;
 
 
-void     init(const std::string& paths);
-WDLScore probe_wdl(Position& pos, ProbeState* result);
-int      probe_dtz(Position& pos, ProbeState* result);
-bool     root_probe(Position& pos, Search::RootMoves& rootMoves, bool rule50, bool rankDTZ);
-bool     root_probe_wdl(Position& pos, Search::RootMoves& rootMoves, bool rule50);
-Config   rank_root_moves(const OptionsMap&  options,
-                         Position&          pos,
-                         Search::RootMoves& rootMoves,
-                         bool               rankDTZ = false);
+void       init(const std::string& paths,
+                PreloadMode        preload,
+                bool               lock,
+                size_t             blockIndexMB,
+                ThreadPool&        threads);
+MapStats   map_stats();
+ProbeStats probe_stats();
+void       collect_probe_stats(bool enable);
+void       reset_stats();
+void       prefetch(const Position& pos, ProbeCache* cache = nullptr);
+bool       record_probes(const std::string& file);
+void       replay_probes(const std::string& file, int iterations);
+WDLScore   probe_wdl(Position& pos, ProbeState* result, ProbeCache* cache = nullptr);
+int        probe_dtz(Position& pos, ProbeState* result, ProbeCache* cache = nullptr);
+bool       root_probe(Position&          pos,
+                      Search::RootMoves& rootMoves,
+                      bool               rule50,
+                      bool               rankDTZ,
+                      ProbeCache*        cache   = nullptr,
+                      ThreadPool*        threads = nullptr);
+bool       root_probe_wdl(Position&          pos,
+                          Search::RootMoves& rootMoves,
+                          bool               rule50,
+                          ProbeCache*        cache   = nullptr,
+                          ThreadPool*        threads = nullptr);
+Config     rank_root_moves(const OptionsMap&  options,
+                           Position&          pos,
+                           Search::RootMoves& rootMoves,
+                           bool               rankDTZ = false,
+                           ProbeCache*        cache   = nullptr,
+                           ThreadPool*        threads = nullptr);
 
 }  // namespace Stockfish::Tablebases
 
@@ -41,20 +41,31 @@ namespace Stockfish {
 Thread::Thread(Search::SharedState&                    sharedState,
                std::unique_ptr<Search::ISearchManager> sm,
                size_t                                  n,
-               OptionalThreadToNumaNodeBinder          binder) :
+               OptionalThreadToNumaNodeBinder          binder,
+               LargePagePtr<Search::SharedHistories>*  sharedHistories) :
     idx(n),
     nthreads(sharedState.options["Threads"]),
     stdThread(&Thread::idle_loop, this) {
 
     wait_for_search_finished();
 
-    run_custom_job([this, &binder, &sharedState, &sm, n]() {
+    run_custom_job([this, &binder, &sharedState, &sm, n, sharedHistories]() {
         // Use the binder to [maybe] bind the threads to a NUMA node before doing
         // the Worker allocation. Ideally we would also allocate the SearchManager
-        // here, but that's minor.
+        // here, but that's minor. The Worker holds several MB of history tables,
+        // which are first touched here on the local node, and are backed by
+        // large pages when available to save TLB misses.
         [[maybe_unused]] const auto token = binder();
-        this->worker =
-          std::make_unique<Search::Worker>(sharedState, std::move(sm), n);
+
+        // Shared histories are allocated, and later cleared, by the first
+        // thread of their NUMA node
+        const bool firstOnNode = sharedHistories && !*sharedHistories;
+        if (firstOnNode)
+            *sharedHistories = make_unique_large_page<Search::SharedHistories>();
+
+        this->worker = make_unique_large_page<Search::Worker>(
+          sharedState, std::move(sm), n, sharedHistories ? sharedHistories->get() : nullptr,
+          firstOnNode);
     });
 
     wait_for_search_finished();
@@ -128,15 +139,50 @@ void Thread::idle_loop() {
 
 Search::SearchManager* ThreadPool::main_manager() { return main_thread()->worker->main_manager(); }
 
-uint64_t ThreadPool::nodes_searched() const { return accumulate(&Search::Worker::nodes); }
-uint64_t ThreadPool::tb_hits() const { return accumulate(&Search::Worker::tbHits); }
+uint64_t ThreadPool::nodes_searched() const {
+    return accumulate(&Search::SharedCounters::nodes);
+}
+uint64_t ThreadPool::tb_hits() const { return accumulate(&Search::SharedCounters::tbHits); }
+
+// Microseconds between the start of start_thinking() and the first node of the
+// slowest thread. Like tt_stats(), this must not be called while searching.
+uint64_t ThreadPool::start_latency() const {
+
+    uint64_t latency = 0;
+    for (auto&& th : threads)
+        latency = std::max(latency, th->worker->startLatency);
+    return latency;
+}
+
+// Microseconds spent by the last start_thinking() until the root moves were
+// ranked, mostly probing the tablebases when the root position is in them
+uint64_t ThreadPool::tb_root_probe_time() const { return tbRootProbeMicros; }
+
+// The counters are not atomic, so this must not be called while searching
+TTStats ThreadPool::tt_stats() const {
+
+    TTStats sum;
+    for (auto&& th : threads)
+        sum += th->worker->ttStats;
+    return sum;
+}
+
+// Like tt_stats(), this must not be called while searching
+Tablebases::ProbeCacheStats ThreadPool::tb_cache_stats() const {
+
+    Tablebases::ProbeCacheStats sum;
+    for (auto&& th : threads)
+        sum += th->worker->tbCache.stats;
+    return sum;
+}
 
 // Creates/destroys threads to match the requested number.
 // Created and launched threads will immediately go to sleep in idle_loop.
 // Upon resizing, threads are recreated to allow for binding if necessary.
 void ThreadPool::set(const NumaConfig&                           numaConfig,
                      Search::SharedState                         sharedState,
-                     const Search::SearchManager::UpdateContext& updateContext) {
+                     const Search::SearchManager::UpdateContext& updateContext,
+                     size_t                                      requested) {
 
     if (threads.size() > 0)  // destroy any existing thread(s)
     {
@@ -145,10 +191,9 @@ void ThreadPool::set(const NumaConfig&                           numaConfig,
         threads.clear();
 
         boundThreadToNumaNode.clear();
+        sharedHistories.clear();
     }
 
-    const size_t requested = sharedState.options["Threads"];
-
     if (requested > 0)  // create new thread(s)
     {
         // Binding threads may be problematic when there's multiple NUMA nodes and
@@ -169,6 +214,8 @@ void ThreadPool::set(const NumaConfig&                           numaConfig,
             return true;
         }();
 
+        const bool shareHistories = sharedState.options["Shared History"];
+
         boundThreadToNumaNode = doBindThreads
                                 ? numaConfig.distribute_threads_among_numa_nodes(requested)
                                 : std::vector<NumaIndex>{};
@@ -188,8 +235,9 @@ void ThreadPool::set(const NumaConfig&                           numaConfig,
             auto binder = doBindThreads ? OptionalThreadToNumaNodeBinder(numaConfig, numaId)
                                         : OptionalThreadToNumaNodeBinder(numaId);
 
-            threads.emplace_back(
-              std::make_unique<Thread>(sharedState, std::move(manager), threadId, binder));
+            threads.emplace_back(std::make_unique<Thread>(
+              sharedState, std::move(manager), threadId, binder,
+              shareHistories ? &sharedHistories[numaId] : nullptr));
         }
 
         clear();
@@ -199,25 +247,41 @@ void ThreadPool::set(const NumaConfig&                           numaConfig,
 }
 
 
-// Sets threadPool data to initial values
-void ThreadPool::clear() {
+// Sets threadPool data to initial values. A deferred clear only marks the
+// workers, which then clear their histories concurrently as the first step of
+// the next search, see start_thinking().
+void ThreadPool::clear(bool deferred) {
     if (threads.size() == 0)
         return;
 
-    for (auto&& th : threads)
-        th->clear_worker();
+    if (deferred)
+        for (auto&& th : threads)
+            th->worker->clearPending = true;
+    else
+    {
+        for (auto&& th : threads)
+            th->clear_worker();
 
-    for (auto&& th : threads)
-        th->wait_for_search_finished();
+        for (auto&& th : threads)
+            th->wait_for_search_finished();
+    }
 
-    // These two affect the time taken on the first move of a game:
-    main_manager()->bestPreviousAverageScore = VALUE_INFINITE;
-    main_manager()->previousTimeReduction    = 0.85;
+    main_manager()->clear();
+}
+
+// Blocks until stop is raised or keepWaiting() returns false. Whoever changes
+// either of them while the main thread may be waiting must call notify_stop().
+void ThreadPool::wait_for_stop(const std::function<bool()>& keepWaiting) {
+    std::unique_lock<std::mutex> lk(stopMutex);
+    stopCondition.wait(lk, [&] { return flags.stop || !keepWaiting(); });
+}
 
-    main_manager()->callsCnt           = 0;
-    main_manager()->bestPreviousScore  = VALUE_INFINITE;
-    main_manager()->originalTimeAdjust = -1;
-    main_manager()->tm.clear();
+void ThreadPool::notify_stop() {
+    // Taking the lock orders the flag change before a waiter checks its
+    // predicate, so the wake-up cannot be lost.
+    std::unique_lock<std::mutex> lk(stopMutex);
+    lk.unlock();
+    stopCondition.notify_all();
 }
 
 void ThreadPool::run_on_thread(size_t threadId, std::function<void()> f) {
@@ -233,24 +297,15 @@ void ThreadPool::wait_on_thread(size_t threadId) {
 size_t ThreadPool::num_threads() const { return threads.size(); }
 
 
-// Wakes up main thread waiting in idle_loop() and returns immediately.
-// Main thread will wake up other threads and start the search.
-void ThreadPool::start_thinking(const OptionsMap&  options,
-                                Position&          pos,
-                                StateListPtr&      states,
-                                Search::LimitsType limits) {
+namespace {
 
-    main_thread()->wait_for_search_finished();
-
-    main_manager()->stopOnPonderhit = stop = abortedSearch = false;
-    main_manager()->ponder                                 = limits.ponderMode;
-
-    increaseDepth = true;
+// Returns the legal moves of pos, or those of searchmoves if any of them is legal
+Search::RootMoves root_moves(const Position& pos, const std::vector<std::string>& searchmoves) {
 
     Search::RootMoves rootMoves;
     const auto        legalmoves = MoveList<LEGAL>(pos);
 
-    for (const auto& uciMove : limits.searchmoves)
+    for (const auto& uciMove : searchmoves)
     {
         auto move = UCIEngine::to_move(pos, uciMove);
 
@@ -262,7 +317,58 @@ void ThreadPool::start_thinking(const OptionsMap&  options,
         for (const auto& m : legalmoves)
             rootMoves.emplace_back(m);
 
-    Tablebases::Config tbConfig = Tablebases::rank_root_moves(options, pos, rootMoves);
+    return rootMoves;
+}
+
+}
+
+// Runs on the thread of the worker, which first does a pending deferred clear.
+// The root position is copied, earlier states are shared since they are read-only.
+void ThreadPool::set_root(Search::Worker&           worker,
+                          const Position&           pos,
+                          const Search::RootMoves&  rootMoves,
+                          const Search::LimitsType& limits,
+                          const Tablebases::Config& tbConfig,
+                          bool                      collectTTStats) {
+    if (worker.clearPending)
+        worker.clear();
+
+    worker.limits = limits;
+    worker.nodes = worker.tbHits = worker.nmpMinPly = worker.bestMoveChanges = 0;
+    worker.rootDepth = worker.completedDepth = 0;
+    worker.startLatency                      = 0;
+    worker.publish_counters();
+    worker.rootMoves = rootMoves;
+    worker.rootPos.set(pos, &worker.rootState);
+    worker.tbConfig   = tbConfig;
+    worker.ttCounters = collectTTStats ? &worker.ttStats : nullptr;
+}
+
+// Wakes up main thread waiting in idle_loop() and returns immediately.
+// Main thread will wake up other threads and start the search.
+void ThreadPool::start_thinking(const OptionsMap&  options,
+                                Position&          pos,
+                                StateListPtr&      states,
+                                Search::LimitsType limits) {
+
+    main_thread()->wait_for_search_finished();
+
+    goTime = std::chrono::steady_clock::now();
+
+    main_manager()->stopOnPonderhit = flags.stop = flags.abortedSearch = false;
+    main_manager()->ponder                                             = limits.ponderMode;
+
+    flags.increaseDepth = true;
+
+    Search::RootMoves rootMoves = root_moves(pos, limits.searchmoves);
+
+    // The threads are idle, so they share the probes of the root moves
+    Tablebases::Config tbConfig =
+      Tablebases::rank_root_moves(options, pos, rootMoves, false, nullptr, this);
+
+    tbRootProbeMicros = std::chrono::duration_cast<std::chrono::microseconds>(
+                          std::chrono::steady_clock::now() - goTime)
+                          .count();
 
     // After ownership transfer 'states' becomes empty, so if we stop the search
     // and call 'go' again without setting a new position states.get() == nullptr.
@@ -271,24 +377,14 @@ void ThreadPool::start_thinking(const OptionsMap&  options,
     if (states.get())
         setupStates = std::move(states);  // Ownership transfer, states is now empty
 
-    // We use Position::set() to set root position across threads. But there are
-    // some StateInfo fields (previous, pliesFromNull, capturedPiece) that cannot
-    // be deduced from a fen string, so set() clears them and they are set from
-    // setupStates->back() later. The rootState is per thread, earlier states are
-    // shared since they are read-only.
+    const bool collectTTStats = options["TTStats"];
+
+    // All threads set up their root concurrently from the same snapshot: pos
+    // and its state, the root moves and the TB config, which are read-only here.
     for (auto&& th : threads)
-    {
         th->run_custom_job([&]() {
-            th->worker->limits = limits;
-            th->worker->nodes = th->worker->tbHits = th->worker->nmpMinPly =
-              th->worker->bestMoveChanges          = 0;
-            th->worker->rootDepth = th->worker->completedDepth = 0;
-            th->worker->rootMoves                              = rootMoves;
-            th->worker->rootPos.set(pos.fen(), pos.is_chess960(), &th->worker->rootState);
-            th->worker->rootState = setupStates->back();
-            th->worker->tbConfig  = tbConfig;
+            set_root(*th->worker, pos, rootMoves, limits, tbConfig, collectTTStats);
         });
-    }
 
     for (auto&& th : threads)
         th->wait_for_search_finished();
@@ -296,6 +392,57 @@ void ThreadPool::start_thinking(const OptionsMap&  options,
     main_thread()->start_searching();
 }
 
+// Searches the positions given by next() until it returns false, each thread
+// searching a position of its own alone, so the threads never wait for each
+// other. next(i, pos, st) is called by thread i, concurrently with the other
+// threads, and sets up its next root in pos and st. The updates of the search of thread i go to
+// updates[i]. Blocks until all the searches are done.
+void ThreadPool::search_batch(const OptionsMap&                                        options,
+                              const Search::LimitsType&                                limits,
+                              const std::function<bool(size_t, Position&, StateInfo&)>&        next,
+                              const std::vector<Search::SearchManager::UpdateContext>& updates) {
+
+    assert(updates.size() == threads.size());
+
+    main_thread()->wait_for_search_finished();
+
+    goTime = std::chrono::steady_clock::now();
+
+    const bool collectTTStats = options["TTStats"];
+
+    for (size_t i = 0; i < threads.size(); ++i)
+        run_on_thread(i, [&, i]() {
+            Search::Worker&     worker = *threads[i]->worker;
+            Search::SearchFlags searchFlags;
+            Position            pos;
+            StateInfo           st;
+
+            auto sm = std::make_unique<Search::SearchManager>(updates[i]);
+            sm->clear();
+            sm->ponder = sm->stopOnPonderhit = false;
+
+            std::unique_ptr<Search::ISearchManager> manager = std::move(sm);
+
+            while (next(i, pos, st))
+            {
+                Search::RootMoves  rootMoves = root_moves(pos, limits.searchmoves);
+                Tablebases::Config tbConfig =
+                  Tablebases::rank_root_moves(options, pos, rootMoves, false, &worker.tbCache);
+
+                set_root(worker, pos, rootMoves, limits, tbConfig, collectTTStats);
+                worker.limits.startTime = now();
+
+                searchFlags.stop = searchFlags.abortedSearch = false;
+                searchFlags.increaseDepth                    = true;
+
+                worker.search_alone(manager, searchFlags);
+            }
+        });
+
+    for (size_t i = 0; i < threads.size(); ++i)
+        wait_on_thread(i);
+}
+
 Thread* ThreadPool::get_best_thread() const {
 
     Thread* bestThread = threads.front().get();
@@ -20,14 +20,17 @@
 #define THREAD_H_INCLUDED
 
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <cstddef>
 #include <cstdint>
 #include <functional>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <vector>
 
+#include "memory.h"
 #include "numa.h"
 #include "position.h"
 #include "search.h"
@@ -75,7 +78,8 @@ class Thread {
     Thread(Search::SharedState&,
            std::unique_ptr<Search::ISearchManager>,
            size_t,
-           OptionalThreadToNumaNodeBinder);
+           OptionalThreadToNumaNodeBinder,
+           LargePagePtr<Search::SharedHistories>* sharedHistories);
     virtual ~Thread();
 
     void idle_loop();
@@ -91,8 +95,8 @@ class Thread {
     void   wait_for_search_finished();
     size_t id() const { return idx; }
 
-    std::unique_ptr<Search::Worker> worker;
-    std::function<void()>           jobFunc;
+    LargePagePtr<Search::Worker> worker;
+    std::function<void()>        jobFunc;
 
    private:
     std::mutex                mutex;
@@ -127,25 +131,42 @@ class ThreadPool {
     ThreadPool& operator=(ThreadPool&&)      = delete;
 
     void   start_thinking(const OptionsMap&, Position&, StateListPtr&, Search::LimitsType);
+    void   search_batch(const OptionsMap&,
+                        const Search::LimitsType&,
+                        const std::function<bool(size_t, Position&, StateInfo&)>&,
+                        const std::vector<Search::SearchManager::UpdateContext>&);
     void   run_on_thread(size_t threadId, std::function<void()> f);
     void   wait_on_thread(size_t threadId);
     size_t num_threads() const;
-    void   clear();
+    void   clear(bool deferred = false);
     void   set(const NumaConfig& numaConfig,
                Search::SharedState,
-               const Search::SearchManager::UpdateContext&);
+               const Search::SearchManager::UpdateContext&,
+               size_t requested);
 
     Search::SearchManager* main_manager();
     Thread*                main_thread() const { return threads.front().get(); }
     uint64_t               nodes_searched() const;
     uint64_t               tb_hits() const;
+    TTStats                tt_stats() const;
+    uint64_t               start_latency() const;
+    uint64_t               tb_root_probe_time() const;
     Thread*                get_best_thread() const;
     void                   start_searching();
     void                   wait_for_search_finished() const;
 
+    // Lets the main thread sleep at the end of a ponder or infinite search
+    // until the GUI sends "stop" or "ponderhit", which call notify_stop().
+    void wait_for_stop(const std::function<bool()>& keepWaiting);
+    void notify_stop();
+
+    Tablebases::ProbeCacheStats tb_cache_stats() const;
+
     std::vector<size_t> get_bound_thread_count_by_numa_node() const;
 
-    std::atomic_bool stop, abortedSearch, increaseDepth;
+    Search::SearchFlags flags;
+
+    std::chrono::steady_clock::time_point goTime;  // Set by start_thinking()
 
     auto cbegin() const noexcept { return threads.cbegin(); }
     auto begin() noexcept { return threads.begin(); }
@@ -155,15 +176,30 @@ class ThreadPool {
     auto empty() const noexcept { return threads.empty(); }
 
    private:
+    // Gives the worker its root and limits for the next search
+    static void set_root(Search::Worker&           worker,
+                         const Position&           pos,
+                         const Search::RootMoves&  rootMoves,
+                         const Search::LimitsType& limits,
+                         const Tablebases::Config& tbConfig,
+                         bool                      collectTTStats);
+
+    uint64_t                             tbRootProbeMicros = 0;
     StateListPtr                         setupStates;
     std::vector<std::unique_ptr<Thread>> threads;
     std::vector<NumaIndex>               boundThreadToNumaNode;
 
-    uint64_t accumulate(std::atomic<uint64_t> Search::Worker::* member) const {
+    // With the "Shared History" option, the history tables of each NUMA node
+    std::map<NumaIndex, LargePagePtr<Search::SharedHistories>> sharedHistories;
+    std::mutex                           stopMutex;
+    std::condition_variable              stopCondition;
+
+    // Sums counters published by the workers, which lag by up to 1024 nodes
+    uint64_t accumulate(std::atomic<uint64_t> Search::SharedCounters::* member) const {
 
         uint64_t sum = 0;
         for (auto&& th : threads)
-            sum += (th->worker.get()->*member).load(std::memory_order_relaxed);
+            sum += (th->worker->sharedCounters.*member).load(std::memory_order_relaxed);
         return sum;
     }
 };
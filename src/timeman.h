@@ -53,11 +53,22 @@ class TimeManagement {
     void clear();
     void advance_nodes_time(std::int64_t nodes);
 
+    void      iteration_done(TimePoint elapsed, std::uint64_t nodes);
+    TimePoint next_iteration_time() const;
+
    private:
     TimePoint startTime;
     TimePoint optimumTime;
     TimePoint maximumTime;
 
+    // Elapsed time and nodes searched at the end of the last iterations, the
+    // latest at [iterations % IterationsKept]
+    static constexpr int IterationsKept = 4;
+
+    TimePoint     iterationEnd[IterationsKept];
+    std::uint64_t iterationNodes[IterationsKept];
+    int           iterations;
+
     std::int64_t availableNodes = -1;     // When in 'nodes as time' mode
     bool         useNodesTime   = false;  // True if we are in 'nodes as time' mode
 };
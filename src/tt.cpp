@@ -18,11 +18,15 @@
 
 #include "tt.h"
 
+#include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
+#include <utility>
+#include <vector>
 
 #include "memory.h"
 #include "misc.h"
@@ -32,9 +36,57 @@
 namespace Stockfish {
 
 
-// TTEntry struct is the 10 bytes transposition table entry, defined as below:
+// The geometry of a cluster can be selected at compile time (see `ttcluster` in the
+// Makefile) as the number of entries and the size in bytes of a single entry. The
+// default is 3 entries of 10 bytes each, padded to a 32 bytes cluster.
+#ifndef TT_CLUSTER_ENTRIES
+    #define TT_CLUSTER_ENTRIES 3
+#endif
+
+#ifndef TT_ENTRY_BYTES
+    #define TT_ENTRY_BYTES 10
+#endif
+
+// The entry size determines how many bits of the position key are stored in the entry.
+// Wider keys reduce the number of false hits (see false_hits_estimate()).
+template<int EntryBytes>
+struct EntryKey {
+    static_assert(EntryBytes == 10 || EntryBytes == 12 || EntryBytes == 16,
+                  "Supported TT entry sizes are 10, 12 and 16 bytes");
+};
+
+template<>
+struct EntryKey<10> {
+    using type = uint16_t;
+};
+
+template<>
+struct EntryKey<12> {
+    using type = uint32_t;
+};
+
+template<>
+struct EntryKey<16> {
+    using type = uint64_t;
+};
+
+
+// `genBound8` is where most of the details are. We use the following constants to manipulate 5 leading generation bits
+// and 3 trailing miscellaneous bits.
+
+// These bits are reserved for other things.
+static constexpr unsigned GENERATION_BITS = 3;
+// increment for generation field
+static constexpr int GENERATION_DELTA = (1 << GENERATION_BITS);
+// cycle length
+static constexpr int GENERATION_CYCLE = 255 + GENERATION_DELTA;
+// mask to pull out generation number
+static constexpr int GENERATION_MASK = (0xFF << GENERATION_BITS) & 0xFF;
+
+
+// BasicTTEntry is a transposition table entry, defined as below:
 //
-// key        16 bit
+// key        16, 32 or 64 bit (KeyType)
 // depth       8 bit
 // generation  5 bit
 // pv node     1 bit
@@ -45,8 +97,10 @@ namespace Stockfish {
 //
 // These fields are in the same order as accessed by TT::probe(), since memory is fastest sequentially.
 // Equally, the store order in save() matches this order.
+template<typename KeyT>
+struct BasicTTEntry {
 
-struct TTEntry {
+    using KeyType = KeyT;
 
     // Convert internal bitfields to external types
     TTData read() const {
@@ -55,117 +109,324 @@ struct TTEntry {
                       Bound(genBound8 & 0x3), bool(genBound8 & 0x4)};
     }
 
-    bool is_occupied() const;
-    void save(Key k, Value v, bool pv, Bound b, Depth d, Move m, Value ev, uint8_t generation8);
+    // DEPTH_ENTRY_OFFSET exists because 1) we use `bool(depth8)` as the occupancy check, but
+    // 2) we need to store negative depths for QS. (`depth8` is the only field with "spare bits":
+    // we sacrifice the ability to store depths greater than 1<<8 less the offset, as asserted in `save`.)
+    bool is_occupied() const { return bool(depth8); }
+
+    void save(Key      k,
+              Value    v,
+              bool     pv,
+              Bound    b,
+              Depth    d,
+              Move     m,
+              Value    ev,
+              uint8_t  generation8,
+              TTStats* stats);
+
     // The returned age is a multiple of TranspositionTable::GENERATION_DELTA
-    uint8_t relative_age(const uint8_t generation8) const;
+    uint8_t relative_age(const uint8_t generation8) const {
+        // Due to our packed storage format for generation and its cyclic
+        // nature we add GENERATION_CYCLE (256 is the modulus, plus what
+        // is needed to keep the unrelated lowest n bits from affecting
+        // the result) to calculate the entry age correctly even after
+        // generation8 overflows into the next cycle.
+        return (GENERATION_CYCLE + generation8 - genBound8) & GENERATION_MASK;
+    }
 
    private:
     friend class TranspositionTable;
 
-    uint16_t key16;
-    uint8_t  depth8;
-    uint8_t  genBound8;
-    Move     move16;
-    int16_t  value16;
-    int16_t  eval16;
+    KeyType key;
+    uint8_t depth8;
+    uint8_t genBound8;
+    Move    move16;
+    int16_t value16;
+    int16_t eval16;
 };
 
-// `genBound8` is where most of the details are. We use the following constants to manipulate 5 leading generation bits
-// and 3 trailing miscellaneous bits.
-
-// These bits are reserved for other things.
-static constexpr unsigned GENERATION_BITS = 3;
-// increment for generation field
-static constexpr int GENERATION_DELTA = (1 << GENERATION_BITS);
-// cycle length
-static constexpr int GENERATION_CYCLE = 255 + GENERATION_DELTA;
-// mask to pull out generation number
-static constexpr int GENERATION_MASK = (0xFF << GENERATION_BITS) & 0xFF;
+struct TTEntry: BasicTTEntry<EntryKey<TT_ENTRY_BYTES>::type> {};
 
-// DEPTH_ENTRY_OFFSET exists because 1) we use `bool(depth8)` as the occupancy check, but
-// 2) we need to store negative depths for QS. (`depth8` is the only field with "spare bits":
-// we sacrifice the ability to store depths greater than 1<<8 less the offset, as asserted in `save`.)
-bool TTEntry::is_occupied() const { return bool(depth8); }
+static_assert(sizeof(TTEntry) == TT_ENTRY_BYTES, "Unexpected TTEntry size");
 
 // Populates the TTEntry with a new node's data, possibly
 // overwriting an old position. The update is not atomic and can be racy.
-void TTEntry::save(
-  Key k, Value v, bool pv, Bound b, Depth d, Move m, Value ev, uint8_t generation8) {
+// If stats is given, the reason for (not) overwriting is recorded there.
+template<typename KeyT>
+void BasicTTEntry<KeyT>::save(Key      k,
+                              Value    v,
+                              bool     pv,
+                              Bound    b,
+                              Depth    d,
+                              Move     m,
+                              Value    ev,
+                              uint8_t  generation8,
+                              TTStats* stats) {
 
     // Preserve the old ttmove if we don't have a new one
-    if (m || uint16_t(k) != key16)
+    if (m || KeyType(k) != key)
         move16 = m;
 
+    if (stats)
+        stats->stores++;
+
     // Overwrite less valuable entries (cheapest checks first)
-    if (b == BOUND_EXACT || uint16_t(k) != key16 || d - DEPTH_ENTRY_OFFSET + 2 * pv > depth8 - 4
+    if (b == BOUND_EXACT || KeyType(k) != key || d - DEPTH_ENTRY_OFFSET + 2 * pv > depth8 - 4
         || relative_age(generation8))
     {
         assert(d > DEPTH_ENTRY_OFFSET);
         assert(d < 256 + DEPTH_ENTRY_OFFSET);
 
-        key16     = uint16_t(k);
+        if (stats)
+        {
+            if (!is_occupied())
+                stats->storesEmpty++;
+            else if (KeyType(k) != key)
+                (relative_age(generation8) ? stats->replacedByAge : stats->replacedByDepth)++;
+            else if (b == BOUND_EXACT)
+                stats->updatedByBound++;
+            else if (d - DEPTH_ENTRY_OFFSET + 2 * pv > depth8 - 4)
+                stats->updatedByDepth++;
+            else
+                stats->updatedByAge++;
+        }
+
+        key       = KeyType(k);
         depth8    = uint8_t(d - DEPTH_ENTRY_OFFSET);
         genBound8 = uint8_t(generation8 | uint8_t(pv) << 2 | b);
         value16   = int16_t(v);
         eval16    = int16_t(ev);
     }
-    else if (depth8 + DEPTH_ENTRY_OFFSET >= 5 && Bound(genBound8 & 0x3) != BOUND_EXACT)
-        depth8--;
+    else
+    {
+        if (stats)
+            stats->storesRefused++;
+
+        if (depth8 + DEPTH_ENTRY_OFFSET >= 5 && Bound(genBound8 & 0x3) != BOUND_EXACT)
+            depth8--;
+    }
 }
 
 
-uint8_t TTEntry::relative_age(const uint8_t generation8) const {
-    // Due to our packed storage format for generation and its cyclic
-    // nature we add GENERATION_CYCLE (256 is the modulus, plus what
-    // is needed to keep the unrelated lowest n bits from affecting
-    // the result) to calculate the entry age correctly even after
-    // generation8 overflows into the next cycle.
-    return (GENERATION_CYCLE + generation8 - genBound8) & GENERATION_MASK;
+
+TTStats& TTStats::operator+=(const TTStats& other) {
+    probes += other.probes;
+    hits += other.hits;
+    stores += other.stores;
+    storesRefused += other.storesRefused;
+    storesEmpty += other.storesEmpty;
+    replacedByAge += other.replacedByAge;
+    replacedByDepth += other.replacedByDepth;
+    updatedByBound += other.updatedByBound;
+    updatedByDepth += other.updatedByDepth;
+    updatedByAge += other.updatedByAge;
+    return *this;
 }
 
 
 // TTWriter is but a very thin wrapper around the pointer
-TTWriter::TTWriter(TTEntry* tte) :
-    entry(tte) {}
+TTWriter::TTWriter(TTEntry* tte, TTStats* st) :
+    entry(tte),
+    stats(st) {}
 
 void TTWriter::write(
   Key k, Value v, bool pv, Bound b, Depth d, Move m, Value ev, uint8_t generation8) {
-    entry->save(k, v, pv, b, d, m, ev, generation8);
+    entry->save(k, v, pv, b, d, m, ev, generation8, stats);
 }
 
 
 // A TranspositionTable is an array of Cluster, of size clusterCount. Each cluster consists of ClusterSize number
 // of TTEntry. Each non-empty TTEntry contains information on exactly one position. The size of a Cluster should
-// divide the size of a cache line for best performance, as the cacheline is prefetched when possible.
-
-static constexpr int ClusterSize = 3;
+// divide the size of a cache line for best performance, as the cacheline is prefetched when possible, so clusters
+// are padded up to the next power of two.
+constexpr size_t cluster_bytes(size_t entriesBytes) {
+    size_t bytes = 1;
+    while (bytes < entriesBytes)
+        bytes *= 2;
+    return bytes;
+}
 
-struct Cluster {
-    TTEntry entry[ClusterSize];
-    char    padding[2];  // Pad to 32 bytes
+template<typename Entry, int Entries>
+struct alignas(cluster_bytes(Entries * sizeof(Entry))) BasicCluster {
+    Entry entry[Entries];
 };
 
-static_assert(sizeof(Cluster) == 32, "Suboptimal Cluster size");
+static constexpr int ClusterSize = TT_CLUSTER_ENTRIES;
+
+struct Cluster: BasicCluster<TTEntry, ClusterSize> {};
+
+static_assert(sizeof(Cluster) <= 64, "Cluster does not fit in a cache line");
+
+// Each of these fits a 64 bytes cache line; 3x10 is the default
+static_assert(sizeof(BasicCluster<BasicTTEntry<uint16_t>, 3>) == 32);
+static_assert(sizeof(BasicCluster<BasicTTEntry<uint16_t>, 6>) == 64);
+static_assert(sizeof(BasicCluster<BasicTTEntry<uint64_t>, 4>) == 64);
+
+
+namespace {
+
+// Returns the smallest key that first_entry() maps to cluster c of a table with
+// n clusters, that is ceil(c * 2^64 / n). Keys map to clusters in increasing order.
+Key first_key(uint64_t c, uint64_t n) {
+#if defined(__GNUC__) && defined(IS_64BIT)
+    __extension__ using uint128 = unsigned __int128;
+    return c ? Key(((uint128(c) << 64) - 1) / n + 1) : 0;
+#else
+    // Long division of c * 2^64 by n, one bit at a time. As c < n the
+    // quotient fits in 64 bits.
+    uint64_t q = 0, r = c;
+    for (int i = 0; i < 64; ++i)
+    {
+        const bool carry = r >> 63;
+        r <<= 1;
+        q <<= 1;
+        if (carry || r >= n)
+        {
+            r -= n;
+            q |= 1;
+        }
+    }
+    return q + (r != 0);
+#endif
+}
+
+// Returns the first and last clusters of a table with n clusters that hold keys
+// of cluster c of a table with m clusters.
+std::pair<size_t, size_t> cluster_range(size_t c, size_t m, size_t n) {
+    const size_t first = mul_hi64(first_key(c, m), n);
+    const size_t last  = c + 1 < m ? mul_hi64(first_key(c + 1, m) - 1, n) : n - 1;
+    return {first, last};
+}
+
+}
 
 
 // Sets the size of the transposition table,
 // measured in megabytes. Transposition table consists
 // of clusters and each cluster consists of ClusterSize number of TTEntry.
+// A table of the same size is kept as it is. Otherwise the entries of the
+// current table are migrated to the new one, if both fit in physical memory.
 void TranspositionTable::resize(size_t mbSize, ThreadPool& threads) {
-    aligned_large_pages_free(table);
+    const size_t newClusterCount = mbSize * 1024 * 1024 / sizeof(Cluster);
+    const size_t newBytes        = newClusterCount * sizeof(Cluster);
 
-    clusterCount = mbSize * 1024 * 1024 / sizeof(Cluster);
+    if (table && newClusterCount == clusterCount)
+        return;
 
-    table = static_cast<Cluster*>(aligned_large_pages_alloc(clusterCount * sizeof(Cluster)));
+    // The old table is resident already, so only the new one must fit in the
+    // memory left. Without a known budget the old entries are lost, as a failed
+    // allocation is seldom reported when memory is overcommitted.
+    if (table && available_memory() < newBytes)
+    {
+        aligned_large_pages_free(table);
+        table = nullptr;
+    }
 
-    if (!table)
+    Cluster* newTable = static_cast<Cluster*>(aligned_large_pages_alloc(newBytes));
+
+    if (!newTable && table)
+    {
+        aligned_large_pages_free(table);
+        table    = nullptr;
+        newTable = static_cast<Cluster*>(aligned_large_pages_alloc(newBytes));
+    }
+
+    if (!newTable)
     {
         std::cerr << "Failed to allocate " << mbSize << "MB for transposition table." << std::endl;
         exit(EXIT_FAILURE);
     }
 
-    clear(threads);
+    Cluster* const oldTable        = table;
+    const size_t   oldClusterCount = clusterCount;
+
+    table        = newTable;
+    clusterCount = newClusterCount;
+
+    if (!oldTable)
+    {
+        clear(threads);
+        return;
+    }
+
+    migrate(oldTable, oldClusterCount, threads);
+    aligned_large_pages_free(oldTable);
+}
+
+
+// Fills the table with the entries of a table of a different size. Each thread
+// builds its own part of the new table: it gathers the entries of the old
+// clusters covering the same key range, and keeps the most valuable of them by
+// the replacement strategy of probe(), that is the deepest and most recent ones.
+// Threads only read the old table and write disjoint clusters, so no locking is
+// needed, and the new memory is first touched by the threads that will use it.
+//
+// With 16 bit and 32 bit keys the cluster of an entry is known only up to the
+// key range of its old cluster, so an entry is kept only when that range is a
+// single new cluster, and dropped otherwise, as probe() would not find it. When
+// the table grows, an entry that does not fit its cluster is dropped rather
+// than evicting another one, so that each entry is stored at most once.
+void TranspositionTable::migrate(const Cluster* oldTable,
+                                 size_t         oldClusterCount,
+                                 ThreadPool&    threads) {
+    constexpr bool FullKeys    = sizeof(TTEntry::KeyType) == sizeof(Key);
+    const size_t   threadCount = threads.num_threads();
+
+    for (size_t i = 0; i < threadCount; ++i)
+    {
+        threads.run_on_thread(i, [this, i, threadCount, oldTable, oldClusterCount]() {
+            const size_t stride  = clusterCount / threadCount;
+            const size_t start   = stride * i;
+            const size_t len     = i + 1 != threadCount ? stride : clusterCount - start;
+            const bool   growing = clusterCount > oldClusterCount;
+
+            auto value = [this](const TTEntry& tte) {
+                return tte.depth8 - tte.relative_age(generation8);
+            };
+
+            for (size_t c = start; c < start + len; ++c)
+            {
+                // Old clusters holding keys of the range of the new cluster c
+                const auto [first, last] = cluster_range(c, clusterCount, oldClusterCount);
+
+                Cluster& cluster = table[c];
+                std::memset(&cluster, 0, sizeof(Cluster));
+
+                for (size_t o = first; o <= last; ++o)
+                {
+                    // New clusters holding keys of the range of the old cluster o
+                    if constexpr (!FullKeys)
+                    {
+                        const auto [l, h] = cluster_range(o, oldClusterCount, clusterCount);
+                        if (l != h)
+                            continue;
+                    }
+
+                    for (const TTEntry& tte : oldTable[o].entry)
+                    {
+                        if (!tte.is_occupied()
+                            || (FullKeys && mul_hi64(tte.key, clusterCount) != c))
+                            continue;
+
+                        TTEntry* replace = &cluster.entry[0];
+                        for (TTEntry& e : cluster.entry)
+                            if (!e.is_occupied() || value(e) < value(*replace))
+                            {
+                                replace = &e;
+                                if (!e.is_occupied())
+                                    break;
+                            }
+
+                        if (!replace->is_occupied() || (!growing && value(tte) > value(*replace)))
+                            *replace = tte;
+                    }
+                }
+            }
+        });
+    }
+
+    for (size_t i = 0; i < threadCount; ++i)
+        threads.wait_on_thread(i);
 }
 
 
@@ -192,21 +453,128 @@ void TranspositionTable::clear(ThreadPool& threads) {
 }
 
 
+// Sets the size of a table used by a single thread, measured in kilobytes.
+// The calling thread allocates and zeroes the memory, so that it is first
+// touched on the NUMA node that thread runs on. A size of zero frees the table.
+void TranspositionTable::resize_local(size_t kbSize) {
+    aligned_large_pages_free(table);
+
+    table        = nullptr;
+    clusterCount = kbSize * 1024 / sizeof(Cluster);
+
+    if (!clusterCount)
+        return;
+
+    table = static_cast<Cluster*>(aligned_large_pages_alloc(clusterCount * sizeof(Cluster)));
+
+    if (!table)
+    {
+        std::cerr << "Failed to allocate " << kbSize << "KB for transposition table." << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    clear_local();
+}
+
+
+// Initializes a table used by a single thread to zero
+void TranspositionTable::clear_local() {
+    generation8 = 0;
+
+    if (table)
+        std::memset(table, 0, clusterCount * sizeof(Cluster));
+}
+
+
+size_t TranspositionTable::kb_size() const { return clusterCount * sizeof(Cluster) / 1024; }
+
+
 // Returns an approximation of the hashtable
 // occupation during a search. The hash is x permill full, as per UCI protocol.
-// Only counts entries which match the current generation.
+// Only counts entries which match the current generation. The sample is made
+// of short runs of clusters spread evenly over the table, so that it is not
+// biased toward the start of the table while each run reads adjacent memory.
 int TranspositionTable::hashfull(int maxAge) const {
-    int maxAgeInternal = maxAge << GENERATION_BITS;
-    int cnt            = 0;
-    for (int i = 0; i < 1000; ++i)
+    constexpr size_t SampleSize = 1000;
+    constexpr size_t RunLength  = 8;
+
+    static_assert(SampleSize % RunLength == 0);
+
+    const int maxAgeInternal = maxAge << GENERATION_BITS;
+    int       cnt            = 0;
+
+    auto count_cluster = [&](size_t idx) {
         for (int j = 0; j < ClusterSize; ++j)
-            cnt += table[i].entry[j].is_occupied()
-                && table[i].entry[j].relative_age(generation8) <= maxAgeInternal;
+            cnt += table[idx].entry[j].is_occupied()
+                && table[idx].entry[j].relative_age(generation8) <= maxAgeInternal;
+    };
+
+    // Small tables are scanned entirely
+    if (clusterCount < SampleSize)
+    {
+        for (size_t i = 0; i < clusterCount; ++i)
+            count_cluster(i);
+
+        return clusterCount ? int(cnt * 1000 / (clusterCount * ClusterSize)) : 0;
+    }
+
+    constexpr size_t Runs   = SampleSize / RunLength;
+    const size_t     stride = clusterCount / Runs;
+
+    for (size_t r = 0; r < Runs; ++r)
+        for (size_t i = r * stride; i < r * stride + RunLength; ++i)
+            count_cluster(i);
 
     return cnt / ClusterSize;
 }
 
 
+TTHistogram& TTHistogram::operator+=(const TTHistogram& other) {
+    empty += other.empty;
+    for (int age = 0; age < AgeCount; ++age)
+        byAge[age] += other.byAge[age];
+    return *this;
+}
+
+
+// Counts every entry of the table by age. Each thread scans its own part of
+// the table, the same split as used by clear(), and the results are summed.
+TTHistogram TranspositionTable::histogram(ThreadPool& threads) const {
+    static_assert(TTHistogram::AgeCount == (GENERATION_CYCLE >> GENERATION_BITS));
+
+    const size_t             threadCount = threads.num_threads();
+    std::vector<TTHistogram> partial(threadCount);
+
+    for (size_t i = 0; i < threadCount; ++i)
+    {
+        threads.run_on_thread(i, [this, i, threadCount, &partial]() {
+            const size_t stride = clusterCount / threadCount;
+            const size_t start  = stride * i;
+            const size_t len    = i + 1 != threadCount ? stride : clusterCount - start;
+
+            TTHistogram& h = partial[i];
+            for (size_t idx = start; idx < start + len; ++idx)
+                for (int j = 0; j < ClusterSize; ++j)
+                {
+                    const TTEntry& tte = table[idx].entry[j];
+                    if (!tte.is_occupied())
+                        h.empty++;
+                    else
+                        h.byAge[tte.relative_age(generation8) >> GENERATION_BITS]++;
+                }
+        });
+    }
+
+    for (size_t i = 0; i < threadCount; ++i)
+        threads.wait_on_thread(i);
+
+    TTHistogram sum;
+    for (const TTHistogram& h : partial)
+        sum += h;
+    return sum;
+}
+
+
 void TranspositionTable::new_search() {
     // increment by delta to keep lower bits as is
     generation8 += GENERATION_DELTA;
@@ -222,16 +590,27 @@ uint8_t TranspositionTable::generation() const { return generation8; }
 // to be replaced later. The replace value of an entry is calculated as its depth
 // minus 8 times its relative age. TTEntry t1 is considered more valuable than
 // TTEntry t2 if its replace value is greater than that of t2.
-std::tuple<bool, TTData, TTWriter> TranspositionTable::probe(const Key key) const {
+std::tuple<bool, TTData, TTWriter> TranspositionTable::probe(const Key key, TTStats* stats) const {
 
     TTEntry* const tte   = first_entry(key);
-    const uint16_t key16 = uint16_t(key);  // Use the low 16 bits as key inside the cluster
+    // Use the low bits as key inside the cluster
+    const auto entryKey = TTEntry::KeyType(key);
+
+    if (stats)
+        stats->probes++;
 
     for (int i = 0; i < ClusterSize; ++i)
-        if (tte[i].key16 == key16)
+        if (tte[i].key == entryKey)
+        {
+            const bool hit = tte[i].is_occupied();
+
+            if (stats)
+                stats->hits += hit;
+
             // This gap is the main place for read races.
             // After `read()` completes that copy is final, but may be self-inconsistent.
-            return {tte[i].is_occupied(), tte[i].read(), TTWriter(&tte[i])};
+            return {hit, tte[i].read(), TTWriter(&tte[i], stats)};
+        }
 
     // Find an entry to be replaced according to the replacement strategy
     TTEntry* replace = tte;
@@ -242,7 +621,7 @@ std::tuple<bool, TTData, TTWriter> TranspositionTable::probe(const Key key) cons
 
     return {false,
             TTData{Move::none(), VALUE_NONE, VALUE_NONE, DEPTH_ENTRY_OFFSET, BOUND_NONE, false},
-            TTWriter(replace)};
+            TTWriter(replace, stats)};
 }
 
 
@@ -250,4 +629,15 @@ TTEntry* TranspositionTable::first_entry(const Key key) const {
     return &table[mul_hi64(key, clusterCount)].entry[0];
 }
 
+
+// A probe for a position that is not in the table still reports a hit when one of
+// the ClusterSize entries of its cluster is occupied and happens to have the same
+// n bit key, which occurs with probability 2^-n per occupied entry.
+uint64_t TranspositionTable::false_hits_estimate(const TTStats& stats) const {
+    constexpr int  KeyBits   = 8 * sizeof(TTEntry::KeyType);
+    const uint64_t misses    = stats.probes - stats.hits;
+    const int      occupancy = hashfull(999);  // per mille of occupied entries
+    return uint64_t(std::ldexp(double(misses) * ClusterSize * occupancy / 1000, -KeyBits));
+}
+
 }  // namespace Stockfish
@@ -66,6 +66,38 @@ struct TTData {
 };
 
 
+// Counters describing how a search thread uses the TT. Each Search::Worker owns one
+// and hands it to `probe`, so the counters are plain integers touched only by their
+// owner. They are summed by the ThreadPool when no search is running.
+struct TTStats {
+    uint64_t probes          = 0;
+    uint64_t hits            = 0;  // Occupied entry with a matching key
+    uint64_t stores          = 0;  // Calls to TTWriter::write()
+    uint64_t storesRefused   = 0;  // Old data judged more valuable and kept
+    uint64_t storesEmpty     = 0;  // Written to an unoccupied entry
+    uint64_t replacedByAge   = 0;  // Evicted another position from an older search
+    uint64_t replacedByDepth = 0;  // Evicted another position of the current search
+    uint64_t updatedByBound  = 0;  // Same position, overwritten because of an exact bound
+    uint64_t updatedByDepth  = 0;  // Same position, overwritten because of a deeper search
+    uint64_t updatedByAge    = 0;  // Same position, overwritten because the entry was stale
+
+    TTStats& operator+=(const TTStats& other);
+};
+
+
+// Number of entries in the whole table for each age, counted in searches since
+// the entry was last written (0 is the current search). Ages wrap around after
+// AgeCount searches, as the generation counter does.
+struct TTHistogram {
+    static constexpr int AgeCount = 32;
+
+    uint64_t empty           = 0;
+    uint64_t byAge[AgeCount] = {};
+
+    TTHistogram& operator+=(const TTHistogram& other);
+};
+
+
 // This is used to make racy writes to the global TT.
 struct TTWriter {
    public:
@@ -74,7 +106,8 @@ struct TTWriter {
    private:
     friend class TranspositionTable;
     TTEntry* entry;
-    TTWriter(TTEntry* tte);
+    TTStats* stats;
+    TTWriter(TTEntry* tte, TTStats* st);
 };
 
 
@@ -85,22 +118,36 @@ class TranspositionTable {
 
     void resize(size_t mbSize, ThreadPool& threads);  // Set TT size
     void clear(ThreadPool& threads);                  // Re-initialize memory, multithreaded
+
+    // A small table owned by a single thread, allocated and cleared by that thread
+    void   resize_local(size_t kbSize);
+    void   clear_local();
+    size_t kb_size() const;
+    bool   empty() const { return clusterCount == 0; }
+
     int  hashfull(int maxAge = 0)
       const;  // Approximate what fraction of entries (permille) have been written to during this root search
+    TTHistogram histogram(ThreadPool& threads) const;  // Exact count over all entries, multithreaded
 
     void
     new_search();  // This must be called at the beginning of each root search to track entry aging
     uint8_t generation() const;  // The current age, used when writing new data to the TT
     std::tuple<bool, TTData, TTWriter>
-    probe(const Key key) const;  // The main method, whose retvals separate local vs global objects
+    probe(const Key key, TTStats* stats = nullptr)
+      const;  // The main method, whose retvals separate local vs global objects
     TTEntry* first_entry(const Key key)
       const;  // This is the hash function; its only external use is memory prefetching.
 
+    // Expected number of probes that matched the stored key of an unrelated position
+    uint64_t false_hits_estimate(const TTStats& stats) const;
+
    private:
     friend struct TTEntry;
 
-    size_t   clusterCount;
-    Cluster* table = nullptr;
+    void migrate(const Cluster* oldTable, size_t oldClusterCount, ThreadPool& threads);
+
+    size_t   clusterCount = 0;
+    Cluster* table        = nullptr;
 
     uint8_t generation8 = 0;  // Size must be not bigger than TTEntry::genBound8
 };
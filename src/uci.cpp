@@ -22,6 +22,8 @@
 #include <cctype>
 #include <cmath>
 #include <cstdint>
+#include <fstream>
+#include <iomanip>
 #include <iterator>
 #include <optional>
 #include <sstream>
@@ -36,9 +38,15 @@
 #include "position.h"
 #include "score.h"
 #include "search.h"
+#include "tt.h"
 #include "types.h"
 #include "ucioption.h"
 
+#ifdef _WIN32
+    #include <fcntl.h>
+    #include <io.h>
+#endif
+
 namespace Stockfish {
 
 constexpr auto BenchmarkCommand = "speedtest";
@@ -52,6 +60,206 @@ struct overload: Ts... {
 template<typename... Ts>
 overload(Ts...) -> overload<Ts...>;
 
+namespace {
+
+// Formats part / total as a percentage with one decimal
+std::string percent(uint64_t part, uint64_t total) {
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(1) << 100.0 * part / std::max(total, uint64_t(1));
+    return ss.str();
+}
+
+// Splits a score as reported in UCI into its kind, 0 for cp and 1 for mate, and
+// its value, in moves for mates. Tablebase scores are reported as large cp values.
+std::pair<int, int> split_score(const Score& s) {
+    constexpr int TB_CP = 20000;
+    const auto    split =
+      overload{[](Score::Mate mate) -> std::pair<int, int> {
+                   return {1, (mate.plies > 0 ? (mate.plies + 1) : mate.plies) / 2};
+               },
+               [](Score::Tablebase tb) -> std::pair<int, int> {
+                   return {0, tb.win ? TB_CP - tb.plies : -TB_CP - tb.plies};
+               },
+               [](Score::InternalUnits units) -> std::pair<int, int> { return {0, units.value}; }};
+
+    return s.visit(split);
+}
+
+// Search updates as JSON lines, one object per line with the same fields as the
+// UCI info and bestmove lines, and a "type" of "info", "currmove" or "bestmove".
+
+std::string json_score(const Score& s) {
+    const auto [kind, value] = split_score(s);
+    return std::string(kind ? "{\"mate\":" : "{\"cp\":") + std::to_string(value) + "}";
+}
+
+void json_update_no_moves(const Engine::InfoShort& info) {
+    sync_cout << "{\"type\":\"info\",\"depth\":" << info.depth
+              << ",\"score\":" << json_score(info.score) << "}" << sync_endl;
+}
+
+void json_update_full(const Engine::InfoFull& info, bool showWDL) {
+    std::stringstream ss;
+
+    ss << "{\"type\":\"info\""                    //
+       << ",\"depth\":" << info.depth               //
+       << ",\"seldepth\":" << info.selDepth         //
+       << ",\"multipv\":" << info.multiPV           //
+       << ",\"score\":" << json_score(info.score);  //
+
+    if (!info.bound.empty())
+        ss << ",\"bound\":\"" << info.bound << '"';
+
+    if (showWDL)
+    {
+        std::string wdl(info.wdl);
+        std::replace(wdl.begin(), wdl.end(), ' ', ',');
+        ss << ",\"wdl\":[" << wdl << ']';
+    }
+
+    ss << ",\"nodes\":" << info.nodes        //
+       << ",\"nps\":" << info.nps            //
+       << ",\"hashfull\":" << info.hashfull  //
+       << ",\"tbhits\":" << info.tbHits      //
+       << ",\"time\":" << info.timeMs        //
+       << ",\"pv\":[";
+
+    for (size_t i = 0; i < info.pv->size(); ++i)
+        ss << (i ? ",\"" : "\"") << UCIEngine::move((*info.pv)[i], info.chess960) << '"';
+
+    ss << "]}";
+
+    sync_cout << ss.str() << sync_endl;
+}
+
+void json_iter(const Engine::InfoIter& info) {
+    sync_cout << "{\"type\":\"currmove\",\"depth\":" << info.depth << ",\"currmove\":\""
+              << info.currmove << "\",\"currmovenumber\":" << info.currmovenumber << "}"
+              << sync_endl;
+}
+
+void json_bestmove(std::string_view bestmove, std::string_view ponder) {
+    sync_cout << "{\"type\":\"bestmove\",\"bestmove\":\"" << bestmove << '"';
+    if (!ponder.empty())
+        std::cout << ",\"ponder\":\"" << ponder << '"';
+    std::cout << "}" << sync_endl;
+}
+
+// Search updates as binary records. A record starts with a zero byte, which
+// no text line like 'readyok' does, then the size of the rest of the record as
+// a 16-bit integer, and its type. Integers are little-endian. Moves take 16 bits,
+// from | to << 6 | promotion << 12, with squares and castling as in UCI and the
+// promotion as a PieceType, and are 0 when missing. Scores are a byte, 0 for cp
+// and 1 for mate, followed by their 32-bit value. The payloads are:
+//
+// Info:     depth (16), seldepth (16), multipv (16), score, bound (8, 0 for exact,
+//           1 for lower and 2 for upper), nodes (64), nps (64), tbhits (64),
+//           time (64), hashfull (16), pv length (16) and pv moves. Without legal
+//           moves, only depth and score are set.
+// Currmove: depth (16), currmove, currmovenumber (16)
+// Bestmove: bestmove, ponder
+
+enum RecordType : uint8_t {
+    INFO_RECORD = 1,
+    CURRMOVE_RECORD,
+    BESTMOVE_RECORD
+};
+
+class Record {
+   public:
+    explicit Record(RecordType type) :
+        data(3, '\0') {
+        put<uint8_t>(type);
+    }
+
+    template<typename T>
+    Record& put(T v) {
+        for (size_t i = 0; i < sizeof(T); ++i)
+            data += char(uint64_t(v) >> (8 * i));
+        return *this;
+    }
+
+    Record& put(const Score& s) {
+        const auto [kind, value] = split_score(s);
+        return put<uint8_t>(kind).put<int32_t>(value);
+    }
+
+    Record& put(Move m, bool chess960) {
+        if (!m.is_ok())
+            return put<uint16_t>(0);
+
+        Square from = m.from_sq();
+        Square to   = m.to_sq();
+
+        if (m.type_of() == CASTLING && !chess960)
+            to = make_square(to > from ? FILE_G : FILE_C, rank_of(from));
+
+        PieceType promotion = m.type_of() == PROMOTION ? m.promotion_type() : NO_PIECE_TYPE;
+        return put<uint16_t>(int(from) | int(to) << 6 | int(promotion) << 12);
+    }
+
+    // Moves of the search updates other than the pv come in UCI notation
+    Record& put(std::string_view move) {
+        if (move.size() < 4 || move[0] < 'a' || move[0] > 'h')
+            return put<uint16_t>(0);
+
+        const int from = make_square(File(move[0] - 'a'), Rank(move[1] - '1'));
+        const int to   = make_square(File(move[2] - 'a'), Rank(move[3] - '1'));
+        const int promotion =
+          move.size() > 4 ? int(std::string_view(" pnbrqk").find(move[4])) : NO_PIECE_TYPE;
+
+        return put<uint16_t>(from | to << 6 | promotion << 12);
+    }
+
+    void write() {
+        data[1] = char(data.size() - 3);
+        data[2] = char((data.size() - 3) >> 8);
+
+        sync_cout_start();
+        std::cout.write(data.data(), data.size());
+        std::cout.flush();
+        sync_cout_end();
+    }
+
+   private:
+    std::string data;
+};
+
+void binary_update_no_moves(const Engine::InfoShort& info) {
+    Record r(INFO_RECORD);
+    r.put<int16_t>(info.depth).put<int16_t>(0).put<uint16_t>(0).put(info.score);
+    r.put<uint8_t>(0).put<uint64_t>(0).put<uint64_t>(0).put<uint64_t>(0).put<uint64_t>(0);
+    r.put<int16_t>(0).put<uint16_t>(0).write();
+}
+
+void binary_update_full(const Engine::InfoFull& info) {
+    Record r(INFO_RECORD);
+
+    r.put<int16_t>(info.depth).put<int16_t>(info.selDepth).put<uint16_t>(info.multiPV);
+    r.put(info.score).put<uint8_t>(info.bound.empty() ? 0 : info.bound[0] == 'l' ? 1 : 2);
+    r.put<uint64_t>(info.nodes).put<uint64_t>(info.nps).put<uint64_t>(info.tbHits);
+    r.put<uint64_t>(info.timeMs).put<int16_t>(info.hashfull).put<uint16_t>(info.pv->size());
+
+    for (Move m : *info.pv)
+        r.put(m, info.chess960);
+
+    r.write();
+}
+
+void binary_iter(const Engine::InfoIter& info) {
+    Record(CURRMOVE_RECORD)
+      .put<int16_t>(info.depth)
+      .put(info.currmove)
+      .put<uint16_t>(info.currmovenumber)
+      .write();
+}
+
+void binary_bestmove(std::string_view bestmove, std::string_view ponder) {
+    Record(BESTMOVE_RECORD).put(bestmove).put(ponder).write();
+}
+
+}
+
 void UCIEngine::print_info_string(std::string_view str) {
     sync_cout_start();
     for (auto& line : split(str, "\n"))
@@ -76,12 +284,37 @@ UCIEngine::UCIEngine(int argc, char** argv) :
     init_search_update_listeners();
 }
 
+// Sets the listeners for the 'Info Format' option, before each search
 void UCIEngine::init_search_update_listeners() {
-    engine.set_on_iter([](const auto& i) { on_iter(i); });
-    engine.set_on_update_no_moves([](const auto& i) { on_update_no_moves(i); });
-    engine.set_on_update_full(
-      [this](const auto& i) { on_update_full(i, engine.get_options()["UCI_ShowWDL"]); });
-    engine.set_on_bestmove([](const auto& bm, const auto& p) { on_bestmove(bm, p); });
+    const auto& format = engine.get_options()["Info Format"];
+
+    if (format == "json")
+    {
+        engine.set_on_iter([](const auto& i) { json_iter(i); });
+        engine.set_on_update_no_moves([](const auto& i) { json_update_no_moves(i); });
+        engine.set_on_update_full(
+          [this](const auto& i) { json_update_full(i, engine.get_options()["UCI_ShowWDL"]); });
+        engine.set_on_bestmove([](const auto& bm, const auto& p) { json_bestmove(bm, p); });
+    }
+    else if (format == "binary")
+    {
+#ifdef _WIN32
+        _setmode(_fileno(stdout), _O_BINARY);  // Keep '\n' bytes as they are
+#endif
+        engine.set_on_iter([](const auto& i) { binary_iter(i); });
+        engine.set_on_update_no_moves([](const auto& i) { binary_update_no_moves(i); });
+        engine.set_on_update_full([](const auto& i) { binary_update_full(i); });
+        engine.set_on_bestmove([](const auto& bm, const auto& p) { binary_bestmove(bm, p); });
+    }
+    else
+    {
+        engine.set_on_iter([](const auto& i) { on_iter(i); });
+        engine.set_on_update_no_moves([](const auto& i) { on_update_no_moves(i); });
+        engine.set_on_update_full(
+          [this](const auto& i) { on_update_full(i, engine.get_options()["UCI_ShowWDL"]); });
+        engine.set_on_bestmove([](const auto& bm, const auto& p) { on_bestmove(bm, p); });
+    }
+
     engine.set_on_verify_networks([](const auto& s) { print_info_string(s); });
 }
 
@@ -146,6 +379,12 @@ void UCIEngine::loop() {
             benchmark(is);
         else if (token == "d")
             sync_cout << engine.visualize() << sync_endl;
+        else if (token == "tt")
+            transposition_table(is);
+        else if (token == "tb")
+            tablebases(is);
+        else if (token == "batch")
+            batch(is);
         else if (token == "eval")
             engine.trace_eval();
         else if (token == "compiler")
@@ -212,7 +451,11 @@ void UCIEngine::go(std::istringstream& is) {
     if (limits.perft)
         perft(limits);
     else
+    {
+        engine.wait_for_search_finished();
+        init_search_update_listeners();
         engine.go(limits);
+    }
 }
 
 void UCIEngine::bench(std::istream& args) {
@@ -313,6 +556,8 @@ void UCIEngine::benchmark(std::istream& args) {
     setoption(ss);
     ss = std::istringstream("name UCI_Chess960 value false");
     setoption(ss);
+    ss = std::istringstream("name TTStats value true");  // For the TT lines of the summary
+    setoption(ss);
 
     // Warmup
     for (const auto& cmd : setup.commands)
@@ -370,6 +615,13 @@ void UCIEngine::benchmark(std::istream& args) {
         }
     };
 
+    TTStats                     ttStats;
+    Tablebases::ProbeCacheStats tbCacheStats;
+    Tablebases::MapStats        tbMapStats;
+    Tablebases::ProbeStats      tbProbeStats;
+    uint64_t                    totalStartLatency = 0, maxStartLatency = 0;
+    uint64_t                    totalRootProbeTime = 0, maxRootProbeTime = 0;
+
     engine.search_clear();  // search_clear may take a while
 
     for (const auto& cmd : setup.commands)
@@ -392,6 +644,14 @@ void UCIEngine::benchmark(std::istream& args) {
 
             totalTime += now() - elapsed;
 
+            const uint64_t latency = engine.get_start_latency();
+            totalStartLatency += latency;
+            maxStartLatency = std::max(maxStartLatency, latency);
+
+            const uint64_t rootProbeTime = engine.get_tb_root_probe_time();
+            totalRootProbeTime += rootProbeTime;
+            maxRootProbeTime = std::max(maxRootProbeTime, rootProbeTime);
+
             updateHashfullReadings();
 
             nodes += nodesSearched;
@@ -401,10 +661,19 @@ void UCIEngine::benchmark(std::istream& args) {
             position(is);
         else if (token == "ucinewgame")
         {
-            engine.search_clear();  // search_clear may take a while
+            tbCacheStats += engine.get_tb_cache_stats();
+            tbMapStats += engine.get_tb_map_stats();
+            tbProbeStats += engine.get_tb_probe_stats();
+            ttStats += engine.get_tt_stats();  // Counters are reset by search_clear
+            engine.search_clear();             // search_clear may take a while
         }
     }
 
+    ttStats += engine.get_tt_stats();
+    tbCacheStats += engine.get_tb_cache_stats();
+    tbMapStats += engine.get_tb_map_stats();
+    tbProbeStats += engine.get_tb_probe_stats();
+
     totalTime = std::max<TimePoint>(totalTime, 1);  // Ensure positivity to avoid a 'divide by zero'
 
     dbg_print();
@@ -439,9 +708,32 @@ void UCIEngine::benchmark(std::istream& args) {
               << totalHashfull[0] / numHashfullReadings
               << "\n    single game            : " << maxHashfull[1] << ", "
               << totalHashfull[1] / numHashfullReadings
+              << "\nTT probes, hits [%]        : " << ttStats.probes << ", "
+              << percent(ttStats.hits, ttStats.probes)
+              << "\nTT est. false hits [%]     : "
+              << percent(engine.get_tt_false_hits_estimate(ttStats), ttStats.probes)
+              << "\nTT stores, refused [%]     : " << ttStats.stores << ", "
+              << percent(ttStats.storesRefused, ttStats.stores)
+              << "\nTT replaced by age, depth  : " << ttStats.replacedByAge << ", "
+              << ttStats.replacedByDepth
+              << "\nTB cache probes, hits [%]  : " << tbCacheStats.probes << ", "
+              << percent(tbCacheStats.hits, tbCacheStats.probes)
+              << "\nTB lazy maps, avg, max [us]: " << tbMapStats.maps << ", "
+              << tbMapStats.totalMicros / std::max<uint64_t>(tbMapStats.maps, 1) << ", "
+              << tbMapStats.longestMicros
+              << "\nTB maps contended          : " << tbMapStats.contentions
+              << "\nTB maps prefetched         : " << tbMapStats.prefetched
+              << "\nTB root probe max, avg [us]: " << maxRootProbeTime << ", "
+              << totalRootProbeTime / std::max(numGoCommands, 1)
+              << "\nTB probes, avg [ns]        : " << tbProbeStats.probes << ", "
+              << tbProbeStats.nanos / std::max<uint64_t>(tbProbeStats.probes, 1)
+              << "\nTB page faults minor, major: " << tbProbeStats.minorFaults << ", "
+              << tbProbeStats.majorFaults
               << "\nTotal nodes searched       : " << nodes
               << "\nTotal search time [s]      : " << totalTime / 1000.0
-              << "\nNodes/second               : " << 1000 * nodes / totalTime << std::endl;
+              << "\nNodes/second               : " << 1000 * nodes / totalTime
+              << "\nGo latency max, avg [us]   : " << maxStartLatency << ", "
+              << totalStartLatency / std::max(numGoCommands, 1) << std::endl;
 
     // clang-format on
 
@@ -453,6 +745,160 @@ void UCIEngine::setoption(std::istringstream& is) {
     engine.get_options().setoption(is);
 }
 
+// Prints the transposition table counters accumulated by all threads since the
+// last 'ucinewgame', which are only collected with the TTStats option. Must not
+// be used during a search.
+void UCIEngine::transposition_table(std::istringstream& is) {
+    std::string token;
+    is >> token;
+
+    if (token == "stats")
+    {
+        engine.wait_for_search_finished();
+
+        const TTStats st = engine.get_tt_stats();
+
+        // clang-format off
+
+        sync_cout << "Probes                    : " << st.probes
+                  << "\nHits                      : " << st.hits
+                  << " (" << percent(st.hits, st.probes) << "%)"
+                  << "\nEstimated false hits      : " << engine.get_tt_false_hits_estimate(st)
+                  << "\nStores                    : " << st.stores
+                  << "\n  to empty entries        : " << st.storesEmpty
+                  << "\n  evicting, older search  : " << st.replacedByAge
+                  << "\n  evicting, current search: " << st.replacedByDepth
+                  << "\n  updating, exact bound   : " << st.updatedByBound
+                  << "\n  updating, deeper search : " << st.updatedByDepth
+                  << "\n  updating, stale entry   : " << st.updatedByAge
+                  << "\n  refused                 : " << st.storesRefused
+                  << " (" << percent(st.storesRefused, st.stores) << "%)" << sync_endl;
+
+        // clang-format on
+    }
+    else if (token == "histogram")
+    {
+        const TTHistogram h = engine.get_tt_histogram();
+
+        uint64_t total = h.empty;
+        for (uint64_t n : h.byAge)
+            total += n;
+
+        std::stringstream ss;
+        ss << "Entries   : " << total << "\nEmpty     : " << h.empty << " ("
+           << percent(h.empty, total) << "%)";
+
+        // Ages never written to are skipped, as most are after a few searches
+        for (int age = 0; age < TTHistogram::AgeCount; ++age)
+            if (h.byAge[age])
+                ss << "\nAge " << std::setw(2) << age << "    : " << h.byAge[age] << " ("
+                   << percent(h.byAge[age], total) << "%)";
+
+        sync_cout << ss.str() << sync_endl;
+    }
+    else
+        sync_cout << "Usage: tt stats|histogram" << sync_endl;
+}
+
+// Tablebase debugging commands. 'tb stats' prints the probe counters collected
+// with the SyzygyStats option. 'tb record <file>' writes the values decompressed
+// by the following searches, to be replayed by the tbbench tool, and 'tb record'
+// alone stops.
+void UCIEngine::tablebases(std::istringstream& is) {
+    std::string token, file;
+    is >> token >> file;
+
+    if (token == "stats")
+    {
+        engine.wait_for_search_finished();
+
+        const Tablebases::ProbeStats st = engine.get_tb_probe_stats();
+
+        std::stringstream ss;
+        ss << "Probes                    : " << st.probes
+           << "\nAverage time [ns]         : " << st.nanos / std::max<uint64_t>(st.probes, 1)
+           << "\nBlocks read per probe     : " << std::fixed << std::setprecision(2)
+           << double(st.blocks) / std::max<uint64_t>(st.probes, 1)
+           << "\nPage faults minor, major  : " << st.minorFaults << ", " << st.majorFaults;
+
+        // Probes by duration, in buckets of powers of two nanoseconds
+        constexpr int Last = Tablebases::ProbeStats::Buckets - 1;
+        for (int i = 0; i <= Last; ++i)
+            if (st.latency[i])
+                ss << "\n" << (i < Last ? "<  " : ">= ") << std::setw(10)
+                   << (uint64_t(1) << (i < Last ? i : i - 1)) << " ns          : "
+                   << st.latency[i] << " (" << percent(st.latency[i], st.probes) << "%)";
+
+        // The most probed files, which are the ones worth keeping in memory
+        for (size_t i = 0; i < std::min<size_t>(st.tables.size(), 10); ++i)
+            ss << "\n" << std::left << std::setw(26) << st.tables[i].first << std::right
+               << ": " << st.tables[i].second << " (" << percent(st.tables[i].second, st.probes)
+               << "%)";
+
+        sync_cout << ss.str() << sync_endl;
+    }
+    else if (token == "record")
+    {
+        if (!engine.record_tb_probes(file))
+            print_info_string("Could not open " + file + " for recording");
+        else if (!file.empty())
+            print_info_string("Recording tablebase probes to " + file);
+    }
+    else
+        sync_cout << "Usage: tb stats|record [file]" << sync_endl;
+}
+
+// Searches a set of positions in parallel, one per thread, and prints the
+// outcome of each as a 'result' line. The positions are read from the given
+// EPD or FEN file, or else from the following input lines up to a line 'end'.
+// Usage: batch [file <path>] [depth <d>] [nodes <n>] [movetime <ms>] [mate <m>]
+void UCIEngine::batch(std::istringstream& is) {
+    std::string    token, path;
+    std::ifstream  file;
+    std::streampos mark = is.tellg();
+
+    if (is >> token && token == "file")
+        is >> path;
+    else
+    {
+        is.clear();
+        is.seekg(mark);
+    }
+
+    Search::LimitsType limits = parse_limits(is);
+
+    if (!limits.depth && !limits.nodes && !limits.movetime && !limits.mate)
+    {
+        sync_cout << "Usage: batch [file <path>] depth <d> | nodes <n> | movetime <ms> | mate <m>"
+                  << sync_endl;
+        return;
+    }
+
+    if (!path.empty())
+    {
+        file.open(path);
+
+        if (!file)
+        {
+            print_info_string("Unable to open file " + path);
+            return;
+        }
+    }
+
+    TimePoint elapsed = now();
+
+    size_t count = engine.batch(path.empty() ? std::cin : file, limits, [](const auto& r) {
+        sync_cout << "result " << r.id << " depth " << r.depth << " score "
+                  << format_score(r.score) << " nodes " << r.nodes << " bestmove " << r.bestmove
+                  << sync_endl;
+    });
+
+    elapsed = now() - elapsed + 1;  // Ensure positivity to avoid a 'divide by zero'
+
+    print_info_string("batch searched " + std::to_string(count) + " positions in "
+                      + std::to_string(elapsed) + " ms");
+}
+
 std::uint64_t UCIEngine::perft(const Search::LimitsType& limits) {
     auto nodes = engine.perft(engine.fen(), limits.perft, engine.get_options()["UCI_Chess960"]);
     sync_cout << "\nNodes searched: " << nodes << "\n" << sync_endl;
@@ -522,21 +968,8 @@ int win_rate_model(Value v, const Position& pos) {
 }
 
 std::string UCIEngine::format_score(const Score& s) {
-    constexpr int TB_CP = 20000;
-    const auto    format =
-      overload{[](Score::Mate mate) -> std::string {
-                   auto m = (mate.plies > 0 ? (mate.plies + 1) : mate.plies) / 2;
-                   return std::string("mate ") + std::to_string(m);
-               },
-               [](Score::Tablebase tb) -> std::string {
-                   return std::string("cp ")
-                        + std::to_string((tb.win ? TB_CP - tb.plies : -TB_CP - tb.plies));
-               },
-               [](Score::InternalUnits units) -> std::string {
-                   return std::string("cp ") + std::to_string(units.value);
-               }};
-
-    return s.visit(format);
+    const auto [kind, value] = split_score(s);
+    return (kind ? "mate " : "cp ") + std::to_string(value);
 }
 
 // Turns a Value to an integer centipawn number,
@@ -629,7 +1062,10 @@ void UCIEngine::on_update_full(const Engine::InfoFull& info, bool showWDL) {
        << " hashfull " << info.hashfull  //
        << " tbhits " << info.tbHits      //
        << " time " << info.timeMs        //
-       << " pv " << info.pv;             //
+       << " pv";                         //
+
+    for (Move m : *info.pv)
+        ss << ' ' << move(m, info.chess960);
 
     sync_cout << ss.str() << sync_endl;
 }
@@ -65,6 +65,9 @@ class UCIEngine {
     void          benchmark(std::istream& args);
     void          position(std::istringstream& is);
     void          setoption(std::istringstream& is);
+    void          transposition_table(std::istringstream& is);
+    void          batch(std::istringstream& is);
+    void          tablebases(std::istringstream& is);
     std::uint64_t perft(const Search::LimitsType&);
 
     static void on_update_no_moves(const Engine::InfoShort& info);